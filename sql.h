@@ -1,10 +1,39 @@
 #pragma once
 
 #include <vector>
+#include <deque>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
+#include <functional>
+#include <tuple>
+#include <ostream>
+#include <memory_resource>
 
 #include <type_traits>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#if !defined(SQL_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#elif !defined(SQL_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace  {
 
 const std::string& quotes("\"");
@@ -18,6 +47,11 @@ class column;
 
 class column_value;
 class SelectModel;
+class SqlModel;
+class SqlTemplate;
+
+template<typename M>
+std::shared_ptr<const std::decay_t<M>> freeze(M&& model, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 class Param
 {
@@ -35,39 +69,148 @@ private:
     const std::string _param;
 };
 
+template<typename T>
+inline std::string to_value(const T& data);
+
+// first character of [data, end) that needs escaping in a string literal:
+// a quote or NUL
+inline const char* find_escape(const char* data, const char* end)
+{
+#if !defined(SQL_NO_SIMD) && defined(__AVX2__)
+    const __m256i quote32 = _mm256_set1_epi8('\'');
+    const __m256i zero32  = _mm256_setzero_si256();
+
+    for (; end - data >= 32; data += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32),
+                                        _mm256_cmpeq_epi8(chunk, zero32));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(found));
+
+        if (mask)
+            return data + __builtin_ctz(mask);
+    }
+#endif
+#if !defined(SQL_NO_SIMD) && (defined(__AVX2__) || defined(__SSE2__))
+    const __m128i quote = _mm_set1_epi8('\'');
+    const __m128i zero  = _mm_setzero_si128();
+
+    for (; end - data >= 16; data += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i found = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                     _mm_cmpeq_epi8(chunk, zero));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(found));
+
+        if (mask)
+            return data + __builtin_ctz(mask);
+    }
+#endif
+    for (; data != end; ++data)
+    {
+        if (*data == '\'' || *data == '\0')
+            return data;
+    }
+    return end;
+}
+
+// Appends text escaped for a standard string literal: quotes are doubled,
+// backslashes are kept as they are (standard_conforming_strings), and NUL,
+// which no literal can hold, throws std::invalid_argument. Runs without
+// quotes are appended in one piece, so clean text costs about a memcpy. out
+// is any type with append(const char*, size_t), SqlWriter included.
+template<typename S>
+inline void append_escaped(S& out, std::string_view text)
+{
+    const char* data = text.data();
+    const char* end  = data + text.size();
+
+    while (data != end)
+    {
+        const char* special = find_escape(data, end);
+
+        out.append(data, special - data);
+
+        if (special == end)
+            break;
+
+        if (*special == '\0')
+            throw std::invalid_argument("sql: NUL in a string literal");
+
+        out.append("''", 2);
+        data = special + 1;
+    }
+}
+
+// Appends the sql text of a value to out without a temporary. Numbers are
+// formatted by std::to_chars, independent of the locale, floating point values
+// as the shortest text that reads back to the same value.
+template<typename S, typename T>
+inline void append_value(S& out, const T& data)
+{
+    if constexpr (std::is_same<T, std::nullptr_t>::value)
+    {
+        out.append("null", 4);
+    }
+    else if constexpr (std::is_same<T, bool>::value)
+    {
+        out.push_back(data ? '1' : '0');
+    }
+    else if constexpr (std::is_arithmetic<T>::value)
+    {
+        char buffer[64];
+
+        out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), data).ptr);
+    }
+    else if constexpr (std::is_convertible<const T&, std::string_view>::value)
+    {
+        out.push_back('\'');
+        append_escaped(out, data);
+        out.push_back('\'');
+    }
+    else if constexpr (std::is_same<T, Param>::value)
+    {
+        out.append(data.param());
+    }
+    else
+    {
+        out.append(to_value(data));
+    }
+}
+
 template<typename T>
 inline std::string to_value(const T& data)
 {
-    return std::to_string(data);
+    std::string str;
+
+    append_value(str, data);
+    return str;
 }
 
 template<size_t N>
 inline std::string to_value(char const (&data)[N])
 {
-    std::string str("'");
+    std::string str;
 
-    str.append(data);
-    str.append("'");
+    append_value(str, data);
     return str;
 }
 
 template<>
 inline std::string to_value<std::string>(const std::string& data)
 {
-    std::string str("'");
+    std::string str;
 
-    str.append(data);
-    str.append("'");
+    append_value(str, data);
     return str;
 }
 
 template<>
 inline std::string to_value<const char*>(const char* const& data)
 {
-    std::string str("'");
+    std::string str;
 
-    str.append(data);
-    str.append("'");
+    append_value(str, data);
     return str;
 }
 
@@ -95,1651 +238,5260 @@ inline std::string to_value<column_value>(const column_value& data);
    }
  */
 
-template<typename T>
-void join_vector(std::string& result, const std::vector<T>& vec, const char* sep)
+// appends "name" without building a temporary
+template<typename S>
+inline void append_quoted(S& out, std::string_view name)
 {
-    size_t size = vec.size();
-
-    for (size_t i = 0; i < size; ++i)
-    {
-        if (i < size - 1)
-        {
-            result.append(vec[i]);
-            result.append(sep);
-        }
-        else
-        {
-            result.append(vec[i]);
-        }
-    }
+    out.append(quotes);
+    out.append(name);
+    out.append(quotes);
 }
 
-class column
+// Handle of a name interned by SqlIdentifiers, which holds its quoted and
+// schema-qualified form. Copies are a pointer; a handle stays valid as long
+// as its registry.
+class ident
 {
 public:
+    ident() {}
 
-
-    column() {}
-    // alias
-    column(const std::string& column_name, const std::string& alias = "", const std::string& as = "", const std::string& to_type = "")
+    std::string_view name() const
     {
-        if (!alias.empty())
-            _cond.append(alias + ".");
+        return _entry ? std::string_view(_entry->name) : std::string_view();
+    }
 
+    // schema."name", or "name" without a schema
+    std::string_view sql() const
+    {
+        return _entry ? std::string_view(_entry->sql) : std::string_view();
+    }
 
+    // index of the name in its registry
+    uint32_t id() const
+    {
+        return _entry ? _entry->id : UINT32_MAX;
+    }
 
-        _cond.append(quotes + column_name + quotes);
+    explicit operator bool() const
+    {
+        return _entry != nullptr;
+    }
 
-        if (!to_type.empty())
-            _cond.append("::" + to_type);
+    friend bool operator==(const ident& lhs, const ident& rhs)
+    {
+        return lhs._entry == rhs._entry;
+    }
 
-        if (!as.empty())
-            _cond.append(" AS " + as);
+    friend bool operator!=(const ident& lhs, const ident& rhs)
+    {
+        return lhs._entry != rhs._entry;
     }
 
-    column(const column& column_name, const std::string& alias = "", const std::string& as = "", const std::string& to_type = "")
+private:
+    friend class SqlIdentifiers;
+
+    struct entry
     {
-        if (!alias.empty())
-            _cond.append(alias + ".");
-        _cond.append(column_name.str());
+        std::string name;
+        std::string sql;
+        uint32_t id;
+    };
 
-        if (!to_type.empty())
-            _cond.append("::" + to_type);
+    explicit ident(const entry* e) :
+        _entry(e) {}
 
-        if (!as.empty())
-            _cond.append(" AS " + as);
-    }
+    const entry* _entry = nullptr;
+};
 
-    column& operator()(const std::string& column_name, const std::string& alias = "", const std::string& as = "")
+// appends the interned quoted form with a single copy
+template<typename S>
+inline void append_quoted(S& out, const ident& name)
+{
+    out.append(name.sql());
+}
+
+// Registry of the bounded set of names a service uses, interned once at
+// startup. intern() may be called from any thread; lookups share a lock and
+// the handles themselves are read without one, since entries never move.
+class SqlIdentifiers
+{
+public:
+    SqlIdentifiers() {}
+    SqlIdentifiers(const SqlIdentifiers&)            = delete;
+    SqlIdentifiers& operator=(const SqlIdentifiers&) = delete;
+
+    // handle of name within schema, added on first use
+    ident intern(std::string_view name, std::string_view schema = "")
     {
-        if (!alias.empty())
-            _cond.append(alias + ".");
-        _cond.append(quotes + column_name + quotes);
+        std::string sql = qualified(name, schema);
 
-        if (!as.empty())
-            _cond.append(" AS " + as);
+        {
+            std::shared_lock<std::shared_mutex> lock(_mutex);
+            auto it = _index.find(sql);
 
-        return *this;
+            if (it != _index.end())
+                return ident(it->second);
+        }
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        auto it = _index.find(sql);
+
+        if (it != _index.end())
+            return ident(it->second);
+
+        _entries.push_back(ident::entry{std::string(name), sql, static_cast<uint32_t>(_entries.size())});
+
+        const ident::entry* e = &_entries.back();
+
+        _index.emplace(std::move(sql), e);
+        return ident(e);
     }
 
-    virtual ~column() {}
+    // handle of an interned name, empty if it was never interned
+    ident find(std::string_view name, std::string_view schema = "") const
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto it = _index.find(qualified(name, schema));
 
+        return it != _index.end() ? ident(it->second) : ident();
+    }
 
-    column& is_null()
+    ident operator[](uint32_t id) const
     {
-        _cond.append(" is null");
-        return *this;
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+
+        return id < _entries.size() ? ident(&_entries[id]) : ident();
     }
 
-    column& is_not_null()
+    size_t size() const
     {
-        _cond.append(" is not null");
-        return *this;
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+
+        return _entries.size();
     }
 
-    template<typename T>
-    column& in (const std::vector<T>& args) {
-        size_t size = args.size();
+private:
+    static std::string qualified(std::string_view name, std::string_view schema)
+    {
+        std::string sql;
+
+        sql.reserve(schema.size() + name.size() + 3);
 
+        if (!schema.empty())
+            sql.append(schema).append(".");
+        append_quoted(sql, name);
+        return sql;
+    }
 
+    mutable std::shared_mutex _mutex;
+    // a deque, so the entries handles point to stay in place as it grows
+    std::deque<ident::entry> _entries;
+    std::unordered_map<std::string, const ident::entry*> _index;
+};
 
-        _cond.append(" in (");
+// Destination of a streamed statement. Output is collected in a fixed-size
+// buffer and handed to write() in pieces, so rendering into a sink takes the
+// same memory whatever the size of the statement.
+class SqlSink
+{
+public:
+    SqlSink() {}
+    virtual ~SqlSink() {}
 
-        for (size_t i = 0; i < size; ++i)
+    void append(const char* data, size_t length)
+    {
+        if (_used + length > sizeof(_buffer))
         {
-            if (i < size - 1)
-            {
-                _cond.append(to_value(args[i]));
-                _cond.append(", ");
-            }
-            else
+            flush();
+
+            if (length >= sizeof(_buffer))
             {
-                _cond.append(to_value(args[i]));
+                write(data, length);
+                return;
             }
         }
-        _cond.append(")");
+        std::memcpy(_buffer + _used, data, length);
+        _used += length;
+    }
 
-        return *this;
+    void flush()
+    {
+        if (_used > 0)
+            write(_buffer, _used);
+        _used = 0;
     }
 
-    column& in (const std::string& in_column) {
-        _cond.append(" in (");
+protected:
+    virtual void write(const char* data, size_t length) = 0;
 
-        _cond.append(in_column);
-        _cond.append(" ) ");
-        return *this;
-    }
+private:
+    SqlSink(const SqlSink& data)            = delete;
+    SqlSink& operator=(const SqlSink& data) = delete;
 
+    char _buffer[4096];
+    size_t _used = 0;
+};
 
-    column& append(const std::string& data)
-    {
-        _cond.append(" || '" + data + "' ");
-        return *this;
-    }
+class SqlCallbackSink : public SqlSink
+{
+public:
+    SqlCallbackSink(std::function<void(const char*, size_t)> callback) :
+        _callback(std::move(callback)) {}
+    virtual ~SqlCallbackSink() { flush(); }
 
-    column& prepend(const std::string& data)
+protected:
+    virtual void write(const char* data, size_t length) override
     {
-        _cond.insert(0, " '" + data + "' || ");
-        return *this;
+        _callback(data, length);
     }
 
-    // special characters such as   %,_ must contains in like_condition
-    // template<>
-    column& like(const std::string& like_condition)
+private:
+    std::function<void(const char*, size_t)> _callback;
+};
+
+class SqlStreamSink : public SqlSink
+{
+public:
+    SqlStreamSink(std::ostream& out) :
+        _out(out) {}
+    virtual ~SqlStreamSink() { flush(); }
+
+protected:
+    virtual void write(const char* data, size_t length) override
     {
-        if (like_condition.size() <= 0)
-            return *this;
+        _out.write(data, static_cast<std::streamsize>(length));
+    }
 
-        _cond.append(" LIKE  '");
-        _cond.append(like_condition);
-        _cond.append("' ");
+private:
+    std::ostream& _out;
+};
 
+#if defined(__unix__) || defined(__APPLE__)
+// writes to a file descriptor, stops at the first error, see failed()
+class SqlFdSink : public SqlSink
+{
+public:
+    SqlFdSink(int fd) :
+        _fd(fd) {}
+    virtual ~SqlFdSink() { flush(); }
 
-        return *this;
+    bool failed() const
+    {
+        return _failed;
     }
 
-    template<typename T>
-    column& not_in(const std::vector<T>& args)
+protected:
+    virtual void write(const char* data, size_t length) override
     {
-        size_t size = args.size();
-
-        if (size == 1)
+        while (length > 0 && !_failed)
         {
-            _cond.append(" != ");
-            _cond.append(to_value(args[0]));
-        }
-        else
-        {
-            _cond.append(" not in (");
+            ssize_t written = ::write(_fd, data, length);
 
-            for (size_t i = 0; i < size; ++i)
+            if (written < 0)
             {
-                if (i < size - 1)
-                {
-                    _cond.append(to_value(args[i]));
-                    _cond.append(", ");
-                }
-                else
-                {
-                    _cond.append(to_value(args[i]));
-                }
+                if (errno != EINTR)
+                    _failed = true;
+                continue;
             }
-            _cond.append(")");
+            data   += written;
+            length -= static_cast<size_t>(written);
         }
-        return *this;
     }
 
-    column& operator&&(column& condition)
-    {
-        std::string str("(");
+private:
+    int _fd;
+    bool _failed = false;
+};
+#endif
 
-        str.append(_cond);
-        str.append(") and (");
-        str.append(condition._cond);
-        str.append(")");
-        condition._cond = str;
-        return condition;
-    }
+// Type of a literal value, which decides its quoting when inlined and is
+// reported with it when bound.
+enum class literal_type : uint8_t
+{
+    null,
+    boolean,
+    integer,
+    real,
+    text
+};
 
-    column& operator||(column& condition)
-    {
-        std::string str("(");
+// A literal collected by a binding render, in the text form postgres and most
+// drivers accept for parameters; text values are unquoted.
+template<typename T>
+constexpr literal_type literal_type_of()
+{
+    if constexpr (std::is_same<T, std::nullptr_t>::value)
+        return literal_type::null;
+    else if constexpr (std::is_same<T, bool>::value)
+        return literal_type::boolean;
+    else if constexpr (std::is_integral<T>::value)
+        return literal_type::integer;
+    else if constexpr (std::is_floating_point<T>::value)
+        return literal_type::real;
+    else
+        return literal_type::text;
+}
 
-        str.append(_cond);
-        str.append(") or (");
-        str.append(condition._cond);
-        str.append(")");
-        condition._cond = str;
-        return condition;
-    }
+struct SqlBind
+{
+    literal_type type;
+    std::string text;
+};
 
-    column& operator&&(const std::string& condition)
-    {
-        _cond.append(" and ");
-        _cond.append(condition);
-        return *this;
-    }
+enum class placeholder_style
+{
+    dollar,   // $1, $2, ...
+    question  // ?
+};
 
-    column& operator||(const std::string& condition)
-    {
-        _cond.append(" or ");
-        _cond.append(condition);
-        return *this;
-    }
+// Placeholder style and values of a binding render, see
+// SqlModel::render_to(std::string&, SqlBinds&). Values are numbered across
+// subqueries in the order they appear in the statement.
+struct SqlBinds
+{
+    placeholder_style style = placeholder_style::dollar;
+    std::vector<SqlBind> values;
+};
 
-    column& operator&&(const char* condition)
+const uint64_t fnv_offset = 14695981039346656037ull;
+const uint64_t fnv_prime  = 1099511628211ull;
+
+// FNV-1a of data continuing hash, the same on every run and platform
+inline uint64_t fnv1a(uint64_t hash, const char* data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * fnv_prime;
+    return hash;
+}
+
+// Output target of SqlModel::render(). A writer without a target only counts
+// bytes, which lets exact_size() and render_to() share one code path.
+class SqlWriter
+{
+public:
+    SqlWriter() {}
+    SqlWriter(char* buffer) :
+        _buffer(buffer) {}
+    SqlWriter(std::string& out) :
+        _out(&out) {}
+    SqlWriter(std::pmr::string& out) :
+        _pmr_out(&out) {}
+    SqlWriter(SqlSink& sink) :
+        _sink(&sink) {}
+    // collects the static text of a statement into out and its values into
+    // the slots of tpl
+    SqlWriter(std::string& out, SqlTemplate& tpl) :
+        _out(&out),
+        _template(&tpl) {}
+    // writes a placeholder in place of each literal and collects its value
+    // into binds
+    SqlWriter(std::string& out, SqlBinds& binds) :
+        _out(&out),
+        _binds(&binds) {}
+    // hashes the shape of the statement into fingerprint instead of writing
+    // it, see SqlModel::fingerprint()
+    explicit SqlWriter(uint64_t& fingerprint) :
+        _fingerprint(&fingerprint) {}
+    // writes the statement to out and hashes its shape into fingerprint
+    SqlWriter(std::string& out, uint64_t& fingerprint) :
+        _out(&out),
+        _fingerprint(&fingerprint) {}
+    SqlWriter(std::pmr::string& out, uint64_t& fingerprint) :
+        _pmr_out(&out),
+        _fingerprint(&fingerprint) {}
+
+    void append(const char* data, size_t length)
+    {
+        if (_buffer)
+            std::memcpy(_buffer + _size, data, length);
+        else if (_out)
+            _out->append(data, length);
+        else if (_pmr_out)
+            _pmr_out->append(data, length);
+        else if (_sink)
+            _sink->append(data, length);
+
+        if (_fingerprint && !_unhashed)
+            *_fingerprint = fnv1a(*_fingerprint, data, length);
+        _size += length;
+    }
+
+    void append(std::string_view data)
+    {
+        append(data.data(), data.size());
+    }
+
+    void append(const char* data)
+    {
+        append(data, std::strlen(data));
+    }
+
+    void push_back(char c)
+    {
+        append(&c, 1);
+    }
+
+    // value given at render time, written like a literal node of its type
+    template<typename T>
+    void value(const T& data)
     {
-        _cond.append(" and ");
-        _cond.append(condition);
-        return *this;
+        if constexpr (std::is_same<T, std::nullptr_t>::value)
+        {
+            literal("null", literal_type::null);
+        }
+        else if constexpr (std::is_arithmetic<T>::value)
+        {
+            char buffer[64];
+            char* end = buffer + 1;
+
+            if constexpr (std::is_same<T, bool>::value)
+                buffer[0] = data ? '1' : '0';
+            else
+                end = std::to_chars(buffer, buffer + sizeof(buffer), data).ptr;
+            literal(std::string_view(buffer, end - buffer), literal_type_of<T>());
+        }
+        else if constexpr (std::is_convertible<const T&, std::string_view>::value)
+        {
+            literal(std::string_view(data), literal_type::text);
+        }
+        else if constexpr (std::is_same<T, Param>::value)
+        {
+            param(data.param());
+        }
+        else
+        {
+            append(to_value(data));
+        }
     }
 
-    column& operator||(const char* condition)
+    // rendered value and placeholder text, see SqlTemplate and SqlBinds
+    void literal(std::string_view text, literal_type type);
+    void param(std::string_view text);
+
+    size_t size() const
     {
-        _cond.append(" or ");
-        _cond.append(condition);
-        return *this;
+        return _size;
     }
 
-    template<typename T>
-    column& operator==(const T& data)
+    // renders only the items of chunk of the first " in (" list longer than
+    // limit, see SqlModel::for_each_chunk
+    void split_lists(size_t limit, size_t chunk)
     {
-        _cond.append(" = ");
-        _cond.append(to_value(data));
-        return *this;
+        _split_limit = limit;
+        _split_chunk = chunk;
     }
 
-    template<typename T>
-    column& operator!=(const T& data)
+    // items [first, last) to render of an in-list of count items
+    void list_items(bool splittable, uint32_t count, uint32_t& first, uint32_t& last)
     {
-        _cond.append(" != ");
-        _cond.append(to_value(data));
-        return *this;
+        first = 0;
+        last  = count;
+
+        // lists of any length have one shape
+        if (_fingerprint && !writes())
+        {
+            last = std::min<uint32_t>(count, 1);
+            return;
+        }
+
+        if (!splittable || !_split_limit || count <= _split_limit || _split_items)
+            return;
+        _split_items = count;
+        first = static_cast<uint32_t>(std::min<size_t>(_split_chunk * _split_limit, count));
+        last  = static_cast<uint32_t>(std::min<size_t>(first + _split_limit, count));
     }
 
-    template<typename T>
-    column& operator>=(const T& data)
+    // length of the list split by the last render, 0 if none was
+    size_t split_items() const
     {
-        _cond.append(" >= ");
-        _cond.append(to_value(data));
-        return *this;
+        return _split_items;
     }
 
-    template<typename T>
-    column& operator<=(const T& data)
+    // brackets the in-list items after the first, which are written but
+    // left out of the fingerprint
+    void begin_extra_items()
     {
-        _cond.append(" <= ");
-        _cond.append(to_value(data));
-        return *this;
+        ++_unhashed;
     }
 
-    template<typename T>
-    column& operator>(const T& data)
+    void end_extra_items()
     {
-        _cond.append(" > ");
-        _cond.append(to_value(data));
-        return *this;
+        --_unhashed;
     }
 
-    template<typename T>
-    column& operator<(const T& data)
-    {
-        _cond.append(" < ");
-        _cond.append(to_value(data));
-        return *this;
-    }
+private:
+    bool writes() const
+    {
+        return _buffer || _out || _pmr_out || _sink;
+    }
+
+    char* _buffer = nullptr;
+    std::string* _out = nullptr;
+    std::pmr::string* _pmr_out = nullptr;
+    SqlSink* _sink = nullptr;
+    SqlTemplate* _template = nullptr;
+    SqlBinds* _binds = nullptr;
+    uint64_t* _fingerprint = nullptr;
+    uint32_t _unhashed = 0;  // depth of written text the fingerprint skips
+    size_t _size = 0;
+    size_t _split_limit = 0;
+    size_t _split_chunk = 0;
+    size_t _split_items = 0;
+};
 
-    template<typename T>
-    column& operator/(const T& data)
+template<typename T>
+void join_vector(SqlWriter& result, const std::pmr::vector<T>& vec, const char* sep)
+{
+    size_t size = vec.size();
+
+    for (size_t i = 0; i < size; ++i)
     {
-        _cond.append(" / ");
-        _cond.append(to_value(data));
-        return *this;
+        if (i > 0)
+            result.append(sep);
+        result.append(vec[i]);
     }
+}
 
-    template<typename T>
-    column& operator+(const T& data)
+template<typename S, typename T>
+void join_vector(S& result, const std::pmr::vector<T>& vec, const char* sep)
+{
+    size_t size = vec.size();
+
+    for (size_t i = 0; i < size; ++i)
     {
-        _cond.append(" + ");
-        _cond.append(to_value(data));
-        return *this;
+        if (i < size - 1)
+        {
+            result.append(vec[i]);
+            result.append(sep);
+        }
+        else
+        {
+            result.append(vec[i]);
+        }
     }
+}
 
-    template<typename T>
-    column& operator*(const T& data)
+enum class expr_kind : uint8_t
+{
+    text,       // verbatim sql
+    identifier, // column reference
+    literal,    // value of a literal_type
+    param,      // Param placeholder
+    subquery,   // statement of a SqlModel, rendered with the enclosing one
+    binary,     // lhs op rhs, or (lhs) op (rhs) when parens is set
+    prefix,     // op lhs
+    postfix,    // lhs op
+    in_list     // lhs op item, item, ...)
+};
+
+// Node of a column expression. Children are referenced by index and always
+// precede their parent; in_list items occupy [rhs, rhs + count).
+struct expr_node
+{
+    static const uint32_t npos = UINT32_MAX;
+
+    expr_kind kind;
+    literal_type type = literal_type::null;
+    bool parens = false;
+    uint32_t lhs = npos;
+    uint32_t rhs = npos;
+    uint32_t count = 0;        // subquery: index of the model
+    uint32_t offset = 0;       // own text in expression::text()
+    uint32_t length = 0;
+    const char* op = nullptr;  // static operator text of inner nodes
+};
+
+// Append-only arena holding the nodes of one or more columns. Columns copied
+// from each other share it for reading only; the first change to a shared
+// arena copies it, so no two columns ever append to the same one.
+class expression
+{
+public:
+    expression(std::pmr::memory_resource* resource) :
+        _nodes(resource),
+        _text(resource),
+        _models(resource) {}
+
+    uint32_t add(expr_kind kind, std::string_view text)
     {
-        _cond.append(" * ");
-        _cond.append(to_value(data));
-        return *this;
+        expr_node& node = _nodes.emplace_back();
+
+        node.kind   = kind;
+        node.offset = static_cast<uint32_t>(_text.size());
+        node.length = static_cast<uint32_t>(text.size());
+        _text.append(text);
+        return static_cast<uint32_t>(_nodes.size() - 1);
     }
 
-    template<typename T>
-    column& operator-(const T& data)
+    uint32_t add(literal_type type, std::string_view text)
     {
-        _cond.append(" - ");
-        _cond.append(to_value(data));
-        return *this;
+        uint32_t index = add(expr_kind::literal, text);
+
+        _nodes[index].type = type;
+        return index;
     }
 
-    const std::string& str() const
+    uint32_t add(std::shared_ptr<const SqlModel> model)
     {
-        return _cond;
-    }
+        uint32_t index = add(expr_kind::subquery, "");
 
-    operator bool() {
-        return true;
+        _nodes[index].count = static_cast<uint32_t>(_models.size());
+        _models.push_back(std::move(model));
+        return index;
     }
 
-private:
-    std::string _cond;
-};
+    // literal typed after T, strings are kept unquoted; other values are
+    // taken as sql text
+    template<typename T>
+    uint32_t add_literal(const T& data)
+    {
+        if constexpr (std::is_same<T, std::nullptr_t>::value)
+        {
+            return add(literal_type::null, "null");
+        }
+        else if constexpr (std::is_arithmetic<T>::value)
+        {
+            uint32_t index = add(literal_type_of<T>(), "");
 
+            append_value(_text, data);
+            _nodes[index].length = static_cast<uint32_t>(_text.size() - _nodes[index].offset);
+            return index;
+        }
+        else if constexpr (std::is_convertible<const T&, std::string_view>::value)
+            return add(literal_type::text, std::string_view(data));
+        else
+            return add(expr_kind::text, to_value(data));
+    }
 
-class table
-{
-public:
-    table(const std::string& table_name, const std::string& tablespace = "", const std::string& alias = "")
+    // node for a value on the right-hand side of an operator
+    template<typename T>
+    uint32_t add_value(const T& data)
     {
-        if (!tablespace.empty())
+        if constexpr (std::is_same<T, column>::value)
         {
-            table_str_.append(tablespace);
-            table_str_.append(".");
+            if (!data.expr_tree())
+                return expr_node::npos;
+            return import(*data.expr_tree()) + data.root();
+        }
+        else if constexpr (std::is_same<T, Param>::value)
+        {
+            return add(expr_kind::param, data.param());
         }
-        table_str_.append(quotes + table_name + quotes);
-
-        if (!alias.empty())
-            table_str_.append(" " + alias + " ");
         else
-            table_str_.append(" ");
+        {
+            return add_literal(data);
+        }
     }
 
-    const std::string& str() const
-    { return table_str_;}
+    uint32_t add(expr_kind kind, const char* op, uint32_t lhs, uint32_t rhs = expr_node::npos, bool parens = false)
+    {
+        expr_node& node = _nodes.emplace_back();
 
-private:
-    std::string table_str_ = "";
-};
+        node.kind   = kind;
+        node.op     = op;
+        node.lhs    = lhs;
+        node.rhs    = rhs;
+        node.parens = parens;
+        return static_cast<uint32_t>(_nodes.size() - 1);
+    }
 
-class column_value
-{
-public:
+    uint32_t add_list(const char* op, uint32_t lhs, uint32_t first, uint32_t count)
+    {
+        uint32_t index = add(expr_kind::in_list, op, lhs, first);
+
+        _nodes[index].count = count;
+        return index;
+    }
 
-    column_value(const std::string& column_value, const std::string& to_type = "", const std::string& as = "", const bool& is_value = false)
+    // copies every node of other, returns the index shift applied to them
+    uint32_t import(const expression& other)
     {
-        if (!is_value)
-            _cond.append("'" + column_value + "'");
-        else
-            _cond.append(column_value);
+        uint32_t base   = static_cast<uint32_t>(_nodes.size());
+        uint32_t offset = static_cast<uint32_t>(_text.size());
+        uint32_t models = static_cast<uint32_t>(_models.size());
 
+        _nodes.reserve(_nodes.size() + other._nodes.size());
+        _text.append(other._text);
+        _models.insert(_models.end(), other._models.begin(), other._models.end());
 
-        if (!to_type.empty())
-            _cond.append("::" + to_type);
+        for (expr_node node : other._nodes)
+        {
+            if (node.lhs != expr_node::npos)
+                node.lhs += base;
 
-        if (!as.empty())
-            _cond.append(" AS " +   as);
+            if (node.rhs != expr_node::npos)
+                node.rhs += base;
+
+            if (node.kind == expr_kind::subquery)
+                node.count += models;
+            node.offset += offset;
+            _nodes.push_back(node);
+        }
+        return base;
     }
 
-    const std::string& str() const
+    size_t size() const
     {
-        return _cond;
+        return _nodes.size();
     }
 
-    template<typename T>
-    column_value& operator>(const T& data)
+    void clear()
     {
-        _cond.append(" > ");
-        _cond.append(to_value(data));
-        return *this;
+        _nodes.clear();
+        _text.clear();
+        _models.clear();
     }
 
-    template<typename T>
-    column_value& operator<(const T& data)
+    const expr_node& node(uint32_t index) const
     {
-        _cond.append(" < ");
-        _cond.append(to_value(data));
-        return *this;
+        return _nodes[index];
     }
 
-    template<typename T>
-    column_value& operator*(const T& data)
+    std::string_view text(const expr_node& node) const
     {
-        _cond.append(" * " + to_value(data));
-        return *this;
+        return std::string_view(_text.data() + node.offset, node.length);
     }
 
-private:
-    std::string _cond;
-};
+    void render(SqlWriter& w, uint32_t root) const
+    {
+        if (root == expr_node::npos)
+            return;
 
-template<>
-inline std::string to_value<column>(const column& data)
-{
-    return data.str();
-}
+        if (is_leaf(_nodes[root]))
+        {
+            render_leaf(w, _nodes[root]);
+            return;
+        }
 
-inline std::string to_value(const sql::column_value& data)
-{
-    return data.str();
-}
+        // iterative walk, long and/or chains are as deep as they are long
+        char stack_buffer[64 * sizeof(frame)];
+        std::pmr::monotonic_buffer_resource stack_resource(stack_buffer, sizeof(stack_buffer));
+        std::pmr::vector<frame> stack(&stack_resource);
 
-inline std::string to_value(const std::string& data)
-{
-    return data;
-}
+        stack.push_back({root, 0, 0, 0});
 
-class SqlFunction
-{
-public:
-    SqlFunction() :
-        _sql_func("") {}
-    virtual ~SqlFunction() {}
+        while (!stack.empty())
+        {
+            frame& f            = stack.back();
+            const expr_node& n  = _nodes[f.index];
+            uint32_t next       = expr_node::npos;
 
-    virtual  std::string str() const = 0;
+            switch (n.kind)
+            {
+            case expr_kind::binary:
 
-private:
-    // SqlFunction(const SqlFunction& data)            = delete;
-    SqlFunction& operator=(const SqlFunction& data) = delete;
+                if (f.step == 0)
+                {
+                    if (n.parens)
+                        w.append("(");
+                    next = n.lhs;
+                }
+                else if (f.step == 1)
+                {
+                    if (n.parens)
+                        w.append(")");
+                    w.append(n.op);
 
-protected:
-    std::string _sql_func;
-};
+                    if (n.parens)
+                        w.append("(");
+                    next = n.rhs;
+                }
+                else if (n.parens)
+                {
+                    w.append(")");
+                }
+                break;
 
+            case expr_kind::prefix:
 
-class existsStatement : public SqlFunction
-{
-public:
+                if (f.step == 0)
+                {
+                    w.append(n.op);
+                    next = n.lhs;
+                }
+                break;
 
-    existsStatement()
-    {}
+            case expr_kind::postfix:
 
-    template<typename T>
-    existsStatement& exists(T subq, const std::string& as)
-    {
-        _sql_func.append("EXISTS (");
-        _sql_func.append(to_value(subq));
-        _sql_func.append(") ");
+                if (f.step == 0)
+                    next = n.lhs;
+                else if (f.step == 1)
+                    w.append(n.op);
+                break;
 
-        if  (as.length() > 2)
-            _sql_func.append(" AS " + as  + " ");
+            case expr_kind::in_list:
 
-        return *this;
+                if (f.step == 0)
+                {
+                    w.list_items(std::strcmp(n.op, " in (") == 0, n.count, f.first, f.last);
+                    next = n.lhs;
+                }
+                else if (f.step <= f.last - f.first)
+                {
+                    if (f.step == 2)
+                        w.begin_extra_items();
+                    w.append(f.step == 1 ? n.op : ", ");
+                    next = n.rhs + f.first + f.step - 1;
+                }
+                else
+                {
+                    if (f.last - f.first > 1)
+                        w.end_extra_items();
+                    if (f.first == f.last)
+                        w.append(n.op);
+                    w.append(")");
+                }
+                break;
+
+            default:
+                render_leaf(w, n);
+                break;
+            }
+
+            if (next != expr_node::npos)
+            {
+                ++f.step;
+                stack.push_back({next, 0, 0, 0});
+            }
+            else if (!is_leaf(n) && f.step < last_step(n, f))
+            {
+                ++f.step;
+            }
+            else
+            {
+                stack.pop_back();
+            }
+        }
     }
 
-    virtual   std::string  str() const override
+private:
+    struct frame
     {
-        return _sql_func;
-    }
-};
+        uint32_t index;
+        uint32_t step;
+        uint32_t first;  // in_list items rendered
+        uint32_t last;
+    };
 
-class caseStatement : public SqlFunction
-{
-public:
-    caseStatement()
+    static bool is_leaf(const expr_node& n)
     {
-        _sql_func.append(" END");
+        return n.kind < expr_kind::binary;
     }
 
-    template<typename ... Args>
-    caseStatement& case_sql(std::string as = "", std::string  case_else = "", Args&& ... conditionals)
+    // defined after SqlModel
+    void render_leaf(SqlWriter& w, const expr_node& n) const;
+
+    // number of steps an inner node takes before it is done
+    static uint32_t last_step(const expr_node& n, const frame& f)
     {
-        if (case_else.length() > 2)
-            _sql_func.insert(0, " ELSE '" + case_else + "'");
+        switch (n.kind)
+        {
+        case expr_kind::binary:
+            return 2;
 
-        if (!as.empty())
-            _sql_func.append(" AS " + as);
+        case expr_kind::postfix:
+            return 1;
 
-        case_sql(conditionals ...);
-        return *this;
+        case expr_kind::in_list:
+            return f.last - f.first + 1;
+
+        default:
+            return 0;
+        }
     }
 
-    template<typename T, typename N, typename ... Args>
-    caseStatement& case_sql(std::pair<T, N> when, Args&& ... conditionals)
-    {
-        std::string pb(" WHEN ");
+    std::pmr::vector<expr_node> _nodes;
+    std::pmr::string _text;
+    std::pmr::vector<std::shared_ptr<const SqlModel>> _models;
+};
 
-        pb.append(to_value(when.first));
-        pb.append(" THEN  ");
-        pb.append(to_value(when.second));
+// Rendering of column::in and column::not_in lists
+enum class in_mode
+{
+    expand,    // one literal per element
+    bucketed,  // padded to a power of two elements by repeating the last one,
+               // so lists of any length share a few statement shapes
+    array      // = ANY('{...}'::type[]), a single literal or bind value
+};
 
-        _sql_func.insert(0, pb);
-        case_sql(conditionals ...);
-        return *this;
+// array literal element, strings in double quotes
+template<typename S, typename T>
+inline void append_array_item(S& out, const T& data)
+{
+    if constexpr (std::is_arithmetic<T>::value)
+    {
+        append_value(out, data);
     }
-
-    caseStatement& case_sql()
+    else
     {
-        _sql_func.insert(0, "CASE ");
-        return *this;
+        std::string_view text(data);
+
+        out.push_back('"');
+
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out.push_back('\\');
+            out.push_back(c);
+        }
+        out.push_back('"');
     }
+}
 
-    virtual   std::string  str() const override
+// cast giving a value of T its type where postgres cannot infer it, as in
+// the first row of a VALUES list; none for null and params
+template<typename T>
+inline const char* value_cast()
+{
+    if constexpr (std::is_same<T, std::nullptr_t>::value)
+        return "";
+    else if constexpr (std::is_same<T, bool>::value)
+        return "::bool";
+    else if constexpr (std::is_integral<T>::value)
+    {
+        constexpr size_t size = sizeof(T) * (std::is_unsigned<T>::value ? 2 : 1);
+
+        return size <= 2 ? "::int2" : size <= 4 ? "::int4" : size <= 8 ? "::int8" : "::numeric";
+    }
+    else if constexpr (std::is_floating_point<T>::value)
+        return sizeof(T) <= 4 ? "::float4" : "::float8";
+    else if constexpr (std::is_convertible<const T&, std::string_view>::value)
+        return "::text";
+    else
+        return "";
+}
+
+// cast closing an = ANY( array of T
+template<typename T>
+inline const char* array_cast()
+{
+    if constexpr (std::is_same<T, bool>::value)
+        return "::bool[])";
+    else if constexpr (std::is_integral<T>::value)
     {
-        return _sql_func;
+        constexpr size_t size = sizeof(T) * (std::is_unsigned<T>::value ? 2 : 1);
+
+        return size <= 2 ? "::int2[])" : size <= 4 ? "::int4[])" : size <= 8 ? "::int8[])" : "::numeric[])";
     }
+    else if constexpr (std::is_floating_point<T>::value)
+        return sizeof(T) <= 4 ? "::float4[])" : "::float8[])";
+    else
+        return "::text[])";
+}
 
-    virtual ~caseStatement() {}
+// Tables declared as types, with a nested type per column:
+//
+//   struct User
+//   {
+//       SQL_TABLE(user);
+//       SQL_COLUMN(id, int64_t);
+//       SQL_COLUMN(name, std::string);
+//   };
+//
+// Names and quoted names are string literals put together by the compiler,
+// which the builder copies as they are: SelectModel::select<User::id,
+// User::name>(), from<User>(), InsertModel::insert<User::id>(1).
+#define SQL_TABLE(table) \
+    static constexpr std::string_view sql_name   = #table; \
+    static constexpr std::string_view sql_quoted = "\"" #table "\""
+
+#define SQL_COLUMN(column, ...) \
+    struct column \
+    { \
+        using value_type = __VA_ARGS__; \
+        static constexpr std::string_view sql_name    = #column; \
+        static constexpr std::string_view sql_quoted  = "\"" #column "\""; \
+        static constexpr ::sql::literal_type sql_type = ::sql::literal_type_of<__VA_ARGS__>(); \
+    }
+
+template<typename ... Columns>
+struct column_list {};
+
+// columns a descriptor selects: a column itself, or the sql_columns of a
+// result type
+template<typename T, typename = void>
+struct projection_of
+{
+    using type = column_list<T>;
 };
 
-class SqlWindowFunction : public SqlFunction
+template<typename T>
+struct projection_of<T, std::void_t<typename T::sql_columns>>
+{
+    using type = typename T::sql_columns;
+};
+
+// Result row of exactly the given columns, so selecting it fetches no more
+// than it holds: select<row<User::id, User::name>>()
+template<typename ... Columns>
+class row
 {
 public:
-    SqlWindowFunction()  {}
-    virtual ~SqlWindowFunction() {}
+    using sql_columns = column_list<Columns ...>;
 
-    SqlWindowFunction& row_number(const sql::column& column
-                                  , const sql::column&& partition =  sql::column()
-                                  , const sql::column&& order     =  sql::column()
-                                  , const bool& desc              = false
-                                  , const std::string& as         = "")
+    template<typename Column>
+    auto& get()
     {
-        return w_function("ROW_NUMBER", column.str(), partition.str(), order.str(), desc, as);
+        return std::get<index_of<Column>()>(_values);
     }
 
-    SqlWindowFunction& sum_over(const sql::column& column
-                                , const std::string& partition = ""
-                                , const std::string& order     = ""
-                                , const bool& desc             = false
-                                , const std::string& as        = "")
+    template<typename Column>
+    const auto& get() const
     {
-        return w_function("SUM", column.str(), partition, order, desc,  as);
+        return std::get<index_of<Column>()>(_values);
     }
 
-    SqlWindowFunction& count_over(const sql::column& column
-                                  , const std::string& partition = ""
-                                  , const std::string& order     = ""
-                                  , const bool& desc             = false
-                                  , const std::string& as        = "")
+private:
+    template<typename Column>
+    static constexpr size_t index_of()
     {
-        return w_function("COUNT", column.str(), partition, order, desc, as);
+        size_t index = 0;
+        size_t found = sizeof...(Columns);
+
+        ((std::is_same<Column, Columns>::value ? found = index++ : index++), ...);
+        static_assert(sizeof...(Columns) > 0 && (std::is_same<Column, Columns>::value || ...), "column of the row");
+        return found;
     }
 
-    SqlWindowFunction& count(const sql::column& column)
-    {
+    std::tuple<typename Columns::value_type ...> _values;
+};
+
+class column
+{
+public:
+
+
+    column() {}
+
+    // empty column whose nodes live in resource, name it with operator()
+    explicit column(std::pmr::memory_resource* resource) :
+        _resource(resource) {}
+
+    // alias
+    column(const std::string& column_name, const std::string& alias = "", const std::string& as = "", const std::string& to_type = "")
+    {
+        identifier(column_name, alias, to_type, as);
+    }
+
+    // interned name, copied in without quoting
+    column(const ident& column_name, const std::string& alias = "", const std::string& as = "", const std::string& to_type = "")
+    {
+        identifier(column_name, alias, to_type, as);
+    }
+
+    column(const column& column_name, const std::string& alias = "", const std::string& as = "", const std::string& to_type = "") :
+        _resource(column_name._resource),
+        _expr(column_name._expr),
+        _root(column_name._root)
+    {
+        if (!alias.empty())
+        {
+            std::pmr::string& prefix = scratch();
+
+            prefix.append(alias).append(".");
+            _root = expr().add(expr_kind::binary, "", expr().add(expr_kind::text, prefix), _root);
+        }
+
+        if (!to_type.empty())
+        {
+            std::pmr::string& type = scratch();
+
+            type.append("::").append(to_type);
+            _root = expr().add(expr_kind::binary, "", _root, expr().add(expr_kind::text, type));
+        }
+
+        if (!as.empty())
+        {
+            std::pmr::string& alias_as = scratch();
+
+            alias_as.append(" AS ").append(as);
+            _root = expr().add(expr_kind::binary, "", _root, expr().add(expr_kind::text, alias_as));
+        }
+    }
+
+    column(column&& data) noexcept :
+        _resource(data._resource),
+        _expr(std::move(data._expr)),
+        _root(data._root),
+        _cond(std::move(data._cond)),
+        _cond_valid(data._cond_valid)
+    {
+        data._root       = expr_node::npos;
+        data._cond_valid = false;
+    }
+
+    column& operator=(const column& data) = default;
+
+    column& operator=(column&& data) noexcept
+    {
+        _resource        = data._resource;
+        _expr            = std::move(data._expr);
+        _root            = data._root;
+        _cond            = std::move(data._cond);
+        _cond_valid      = data._cond_valid;
+        data._root       = expr_node::npos;
+        data._cond_valid = false;
+        return *this;
+    }
+
+    column& operator()(const std::string& column_name, const std::string& alias = "", const std::string& as = "")
+    {
+        return identifier(column_name, alias, "", as);
+    }
+
+    column& operator()(const ident& column_name, const std::string& alias = "", const std::string& as = "")
+    {
+        return identifier(column_name, alias, "", as);
+    }
+
+    virtual ~column() {}
+
+    // condition or expression used verbatim
+    static column raw(std::string_view text, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    {
+        column data(resource);
+
+        data.set_root(data.expr().add(expr_kind::text, text));
+        return data;
+    }
+
+    // column declared with SQL_COLUMN
+    template<typename Column>
+    static column of(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    {
+        column data(resource);
+
+        data.set_root(data.expr().add(expr_kind::identifier, Column::sql_quoted));
+        return data;
+    }
+
+
+    column& is_null()
+    {
+        return postfix(" is null");
+    }
+
+    column& is_not_null()
+    {
+        return postfix(" is not null");
+    }
+
+    template<typename T>
+    column& in (const std::vector<T>& args) {
+        return in_list(" in (", args);
+    }
+
+    template<typename T>
+    column& in (const std::vector<T>& args, in_mode mode) {
+        if (mode == in_mode::array)
+            return array(" = ANY(", args);
+
+        return in_list(" in (", args, mode == in_mode::bucketed);
+    }
+
+    column& in (const std::string& in_column) {
+        binary(" in (", expr().add(expr_kind::text, in_column));
+        return postfix(" ) ");
+    }
+
+    // subquery kept as a model, so its values bind with the outer statement;
+    // a temporary is moved rather than copied
+    template<typename M, typename = typename std::enable_if<std::is_base_of<SqlModel, std::decay_t<M>>::value>::type>
+    column& in (M&& subquery) {
+        binary(" in (", expr().add(freeze(std::forward<M>(subquery), _resource)));
+        return postfix(")");
+    }
+
+
+    column& append(const std::string& data)
+    {
+        binary(" || ", quoted_literal(data));
+        return postfix(" ");
+    }
+
+    column& prepend(const std::string& data)
+    {
+        uint32_t lhs = quoted_literal(data);
+
+        set_root(expr().add(expr_kind::prefix, " ",
+                            expr().add(expr_kind::binary, " || ", lhs, _root)));
+        return *this;
+    }
+
+    // special characters such as   %,_ must contains in like_condition
+    // template<>
+    column& like(const std::string& like_condition)
+    {
+        if (like_condition.size() <= 0)
+            return *this;
+
+        binary(" LIKE  ", quoted_literal(like_condition));
+        return postfix(" ");
+    }
+
+    template<typename T>
+    column& between(const T& begin, const T& end)
+    {
+        binary(" BETWEEN ", value(begin));
+        return binary(" AND ", value(end));
+    }
+
+    template<typename T>
+    column& not_in(const std::vector<T>& args)
+    {
+        if (args.size() == 1)
+            return binary(" != ", value(args[0]));
+
+        return in_list(" not in (", args);
+    }
+
+    template<typename T>
+    column& not_in(const std::vector<T>& args, in_mode mode)
+    {
+        if (mode == in_mode::array)
+            return array(" <> ALL(", args);
+
+        if (mode == in_mode::expand)
+            return not_in(args);
+
+        return in_list(" not in (", args, true);
+    }
+
+    column& operator&&(column& condition)
+    {
+        return condition.combine(" and ", *this);
+    }
+
+    column& operator||(column& condition)
+    {
+        return condition.combine(" or ", *this);
+    }
+
+    column& operator&&(const std::string& condition)
+    {
+        return binary(" and ", expr().add(expr_kind::text, condition));
+    }
+
+    column& operator||(const std::string& condition)
+    {
+        return binary(" or ", expr().add(expr_kind::text, condition));
+    }
+
+    column& operator&&(const char* condition)
+    {
+        return binary(" and ", expr().add(expr_kind::text, condition));
+    }
+
+    column& operator||(const char* condition)
+    {
+        return binary(" or ", expr().add(expr_kind::text, condition));
+    }
+
+    template<typename T>
+    column& operator==(const T& data)
+    {
+        return binary(" = ", value(data));
+    }
+
+    template<typename T>
+    column& operator!=(const T& data)
+    {
+        return binary(" != ", value(data));
+    }
+
+    template<typename T>
+    column& operator>=(const T& data)
+    {
+        return binary(" >= ", value(data));
+    }
+
+    template<typename T>
+    column& operator<=(const T& data)
+    {
+        return binary(" <= ", value(data));
+    }
+
+    template<typename T>
+    column& operator>(const T& data)
+    {
+        return binary(" > ", value(data));
+    }
+
+    template<typename T>
+    column& operator<(const T& data)
+    {
+        return binary(" < ", value(data));
+    }
+
+    template<typename T>
+    column& operator/(const T& data)
+    {
+        return binary(" / ", value(data));
+    }
+
+    template<typename T>
+    column& operator+(const T& data)
+    {
+        return binary(" + ", value(data));
+    }
+
+    template<typename T>
+    column& operator*(const T& data)
+    {
+        return binary(" * ", value(data));
+    }
+
+    template<typename T>
+    column& operator-(const T& data)
+    {
+        return binary(" - ", value(data));
+    }
+
+    std::string str() const
+    {
+        return std::string(view());
+    }
+
+    // text of the expression, rendered on first use after a change; valid
+    // until the column changes
+    std::string_view view() const
+    {
+        if (!_cond_valid)
+        {
+            _cond.clear();
+            SqlWriter w(_cond);
+            render(w);
+            _cond_valid = true;
+        }
+        return _cond;
+    }
+
+    void render(SqlWriter& w) const
+    {
+        if (_expr)
+            _expr->render(w, _root);
+    }
+
+    // moves the expression into an arena of its own, which it then shares with
+    // no column it was built from or copied to; an arena the column alone
+    // owns, as after a move, is kept
+    column& detach()
+    {
+        if (_expr && _expr.use_count() > 1)
+        {
+            std::shared_ptr<expression> shared = std::move(_expr);
+
+            if (_root != expr_node::npos)
+                _root += expr().import(*shared);
+        }
+        return *this;
+    }
+
+    // node arena and root of the expression for passes other than rendering,
+    // null for an empty column
+    const expression* expr_tree() const
+    {
+        return _expr.get();
+    }
+
+    uint32_t root() const
+    {
+        return _root;
+    }
+
+    operator bool() {
+        return true;
+    }
+
+private:
+    // arena to add nodes to, copied first when other columns share it
+    expression& expr()
+    {
+        if (!_expr)
+            _expr = std::allocate_shared<expression>(std::pmr::polymorphic_allocator<expression>(_resource), _resource);
+        else if (_expr.use_count() > 1)
+            detach();
+        return *_expr;
+    }
+
+    void set_root(uint32_t root)
+    {
+        _root       = root;
+        _cond_valid = false;
+    }
+
+    // shared by the naming constructors and operator()
+    template<typename Name>
+    column& identifier(const Name& column_name, const std::string& alias, const std::string& to_type, const std::string& as)
+    {
+        std::pmr::string& name = scratch();
+
+        if (!alias.empty())
+            name.append(alias).append(".");
+        append_quoted(name, column_name);
+
+        if (!to_type.empty())
+            name.append("::").append(to_type);
+
+        if (!as.empty())
+            name.append(" AS ").append(as);
+
+        return concat(expr().add(expr_kind::identifier, name));
+    }
+
+    // SelectModel assembles its select list and from clause of text and
+    // subqueries
+    friend class SelectModel;
+
+    column& concat(uint32_t node)
+    {
+        if (_root == expr_node::npos)
+            set_root(node);
+        else
+            binary("", node);
+        return *this;
+    }
+
+    column& concat(std::string_view text)
+    {
+        return concat(expr().add(expr_kind::text, text));
+    }
+
+    column& concat(std::shared_ptr<const SqlModel> model)
+    {
+        return concat(expr().add(std::move(model)));
+    }
+
+    // the column's text buffer, reused to assemble node text without a
+    // temporary from the global heap
+    std::pmr::string& scratch()
+    {
+        _cond.clear();
+        _cond_valid = false;
+        return _cond;
+    }
+
+    uint32_t quoted_literal(const std::string& data)
+    {
+        return expr().add(literal_type::text, data);
+    }
+
+    template<typename T>
+    uint32_t value(const T& data)
+    {
+        if constexpr (std::is_same<T, column>::value)
+        {
+            if (!data._expr || data._expr == _expr)
+                return data._root;
+        }
+        return expr().add_value(data);
+    }
+
+    column& binary(const char* op, uint32_t rhs)
+    {
+        set_root(expr().add(expr_kind::binary, op, _root, rhs));
+        return *this;
+    }
+
+    column& postfix(const char* op)
+    {
+        set_root(expr().add(expr_kind::postfix, op, _root));
+        return *this;
+    }
+
+    template<typename T>
+    column& in_list(const char* op, const std::vector<T>& args, bool bucketed = false)
+    {
+        uint32_t first = static_cast<uint32_t>(expr().size());
+        size_t count   = args.size();
+
+        for (const T& arg : args)
+            expr().add_literal(arg);
+
+        if (bucketed && count > 0)
+        {
+            size_t arity = 1;
+
+            while (arity < count)
+                arity <<= 1;
+
+            for (; count < arity; ++count)
+                expr().add_literal(args.back());
+        }
+
+        set_root(expr().add_list(op, _root, first, static_cast<uint32_t>(count)));
+        return *this;
+    }
+
+    template<typename T>
+    column& array(const char* op, const std::vector<T>& args)
+    {
+        std::pmr::string& items = scratch();
+
+        items.push_back('{');
+
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            if (i > 0)
+                items.push_back(',');
+            append_array_item(items, args[i]);
+        }
+        items.push_back('}');
+        binary(op, expr().add(literal_type::text, items));
+        return postfix(array_cast<T>());
+    }
+
+    // makes this "(lhs) op (this)", importing the smaller arena into the
+    // larger one so chains of and/or stay linear in their length. lhs is the
+    // operand of a non-const operator, so an arena it alone holds may take
+    // the new nodes in place; lhs still sees only its own, and both copy the
+    // arena on their next change as they now share it
+    column& combine(const char* op, column& lhs)
+    {
+        uint32_t lhs_root = lhs._root;
+        uint32_t rhs_root = _root;
+
+        if (lhs._expr && lhs._expr != _expr && lhs_root != expr_node::npos)
+        {
+            if (lhs._expr.use_count() == 1 && (!_expr || _expr->size() < lhs._expr->size()))
+            {
+                std::shared_ptr<expression> rhs = std::move(_expr);
+
+                _expr = lhs._expr;
+
+                if (rhs && rhs_root != expr_node::npos)
+                    rhs_root += _expr->import(*rhs);
+                set_root(_expr->add(expr_kind::binary, op, lhs_root, rhs_root, true));
+                return *this;
+            }
+            lhs_root += expr().import(*lhs._expr);
+        }
+        set_root(expr().add(expr_kind::binary, op, lhs_root, rhs_root, true));
+        return *this;
+    }
+
+    std::pmr::memory_resource* _resource = std::pmr::get_default_resource();
+    std::shared_ptr<expression> _expr;
+    uint32_t _root = expr_node::npos;
+    mutable std::pmr::string _cond{_resource};
+    mutable bool _cond_valid = false;
+};
+
+class table
+{
+public:
+    table(const std::string& table_name, const std::string& tablespace = "", const std::string& alias = "",
+          std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        table_str_(resource)
+    {
+        if (!tablespace.empty())
+        {
+            table_str_.append(tablespace);
+            table_str_.append(".");
+        }
+        append_quoted(table_str_, table_name);
+
+        if (!alias.empty())
+            table_str_.append(" ").append(alias).append(" ");
+        else
+            table_str_.append(" ");
+    }
+
+    table(const ident& table_name, const std::string& alias = "",
+          std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        table_str_(resource)
+    {
+        append_quoted(table_str_, table_name);
+
+        if (!alias.empty())
+            table_str_.append(" ").append(alias).append(" ");
+        else
+            table_str_.append(" ");
+    }
+
+    std::string str() const
+    { return std::string(table_str_);}
+
+    std::string_view view() const
+    { return table_str_;}
+
+private:
+    std::pmr::string table_str_;
+};
+
+class column_value
+{
+public:
+
+    column_value(const std::string& column_value, const std::string& to_type = "", const std::string& as = "", const bool& is_value = false,
+                 std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _cond(resource)
+    {
+        if (!is_value)
+        {
+            _cond.append("'");
+            append_escaped(_cond, column_value);
+            _cond.append("'");
+        }
+        else
+            _cond.append(column_value);
+
+
+        if (!to_type.empty())
+            _cond.append("::").append(to_type);
+
+        if (!as.empty())
+            _cond.append(" AS ").append(as);
+    }
+
+    std::string str() const
+    {
+        return std::string(_cond);
+    }
+
+    std::string_view view() const
+    {
+        return _cond;
+    }
+
+    template<typename T>
+    column_value& operator>(const T& data)
+    {
+        _cond.append(" > ");
+        append_value(_cond, data);
+        return *this;
+    }
+
+    template<typename T>
+    column_value& operator<(const T& data)
+    {
+        _cond.append(" < ");
+        append_value(_cond, data);
+        return *this;
+    }
+
+    template<typename T>
+    column_value& operator*(const T& data)
+    {
+        _cond.append(" * ");
+        append_value(_cond, data);
+        return *this;
+    }
+
+private:
+    std::pmr::string _cond;
+};
+
+template<>
+inline std::string to_value<column>(const column& data)
+{
+    return data.str();
+}
+
+inline std::string to_value(const sql::column_value& data)
+{
+    return data.str();
+}
+
+inline void join_vector(SqlWriter& result, const std::pmr::vector<column>& vec, const char* sep)
+{
+    size_t size = vec.size();
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (i > 0)
+            result.append(sep);
+        vec[i].render(result);
+    }
+}
+
+inline std::string to_value(const std::string& data)
+{
+    return data;
+}
+
+class SqlFunction
+{
+public:
+    SqlFunction(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _sql_func(resource) {}
+    virtual ~SqlFunction() {}
+
+    virtual  std::string str() const = 0;
+
+private:
+    // SqlFunction(const SqlFunction& data)            = delete;
+    SqlFunction& operator=(const SqlFunction& data) = delete;
+
+protected:
+    std::pmr::string _sql_func;
+};
+
+
+class existsStatement : public SqlFunction
+{
+public:
+
+    existsStatement(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        SqlFunction(resource) {}
+
+    template<typename T>
+    existsStatement& exists(T subq, const std::string& as)
+    {
+        _sql_func.append("EXISTS (");
+        _sql_func.append(to_value(subq));
+        _sql_func.append(") ");
+
+        if  (as.length() > 2)
+            _sql_func.append(" AS ").append(as).append(" ");
+
+        return *this;
+    }
+
+    virtual   std::string  str() const override
+    {
+        return std::string(_sql_func);
+    }
+};
+
+class caseStatement : public SqlFunction
+{
+public:
+    caseStatement(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        SqlFunction(resource)
+    {
+        _sql_func.append(" END");
+    }
+
+    template<typename ... Args>
+    caseStatement& case_sql(std::string as = "", std::string  case_else = "", Args&& ... conditionals)
+    {
+        if (case_else.length() > 2)
+        {
+            std::pmr::string pb(" ELSE '", _sql_func.get_allocator());
+
+            pb.append(case_else);
+            pb.append("'");
+            _sql_func.insert(0, pb);
+        }
+
+        if (!as.empty())
+            _sql_func.append(" AS ").append(as);
+
+        case_sql(conditionals ...);
+        return *this;
+    }
+
+    template<typename T, typename N, typename ... Args>
+    caseStatement& case_sql(std::pair<T, N> when, Args&& ... conditionals)
+    {
+        std::pmr::string pb(" WHEN ", _sql_func.get_allocator());
+
+        pb.append(to_value(when.first));
+        pb.append(" THEN  ");
+        pb.append(to_value(when.second));
+
+        _sql_func.insert(0, pb);
+        case_sql(conditionals ...);
+        return *this;
+    }
+
+    caseStatement& case_sql()
+    {
+        _sql_func.insert(0, "CASE ");
+        return *this;
+    }
+
+    virtual   std::string  str() const override
+    {
+        return std::string(_sql_func);
+    }
+
+    virtual ~caseStatement() {}
+};
+
+class SqlWindowFunction : public SqlFunction
+{
+public:
+    SqlWindowFunction(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        SqlFunction(resource) {}
+    virtual ~SqlWindowFunction() {}
+
+    SqlWindowFunction& row_number(const sql::column& column
+                                  , const sql::column&& partition =  sql::column()
+                                  , const sql::column&& order     =  sql::column()
+                                  , const bool& desc              = false
+                                  , const std::string& as         = "")
+    {
+        return w_function("ROW_NUMBER", column.str(), partition.str(), order.str(), desc, as);
+    }
+
+    SqlWindowFunction& sum_over(const sql::column& column
+                                , const std::string& partition = ""
+                                , const std::string& order     = ""
+                                , const bool& desc             = false
+                                , const std::string& as        = "")
+    {
+        return w_function("SUM", column.str(), partition, order, desc,  as);
+    }
+
+    SqlWindowFunction& count_over(const sql::column& column
+                                  , const std::string& partition = ""
+                                  , const std::string& order     = ""
+                                  , const bool& desc             = false
+                                  , const std::string& as        = "")
+    {
+        return w_function("COUNT", column.str(), partition, order, desc, as);
+    }
+
+    SqlWindowFunction& count(const sql::column& column)
+    {
+        _sql_func.clear();
+        _sql_func.append("COUNT(").append(column.view()).append(") ");
+
+        return *this;
+    }
+
+    SqlWindowFunction& dense_rank(
+        const std::string& partition = ""
+        , const std::string& order   = ""
+        , const bool& desc           = false
+        , const std::string& as      = "")
+    {
+        return w_function("DENSE_RANK", "", partition, order, desc, as);
+    }
+
+    SqlWindowFunction& dense_rank(
+        const sql::column& partition = sql::column()
+        , const sql::column& order   = sql::column()
+        , const bool& desc           = false
+        , const std::string& as      = "")
+    {
+        return w_function("DENSE_RANK",  "", partition.str(), order.str(), desc, as);
+    }
+
+    SqlWindowFunction& dense_rank(
+        const sql::column& partition                                    = sql::column()
+        , const std::vector<std::pair<sql::column, bool>> order_by_desc = std::vector<std::pair<sql::column, bool>>
+                                                                          ()
+        , const std::string& as = "")
+    {
+        std::vector<std::pair<std::string, bool>> order_by_desc_string;
+
+        for (int i = 0; i < order_by_desc.size(); i++)
+        {
+            order_by_desc_string.emplace_back(order_by_desc.at(i).first.str(), order_by_desc.at(i).second);
+        }
+
+        // const std::vector<std::pair<std::string, bool>> const_order_by_desc_string = order_by_desc_string;
+        return w_function("DENSE_RANK", "", partition.str(), order_by_desc_string, as);
+    }
+
+    SqlWindowFunction& dense_rank(
+        const std::string& partition                                    = std::string()
+        , const std::vector<std::pair<std::string, bool>> order_by_desc = std::vector<std::pair<std::string, bool>>
+                                                                          ()
+        , const std::string& as = "")
+    {
+        return w_function("DENSE_RANK", "", partition, order_by_desc, as);
+    }
+
+    SqlWindowFunction& rank(
+        const std::string& partition = ""
+        , const std::string& order   = ""
+        , const bool& desc           = false
+        , const std::string& as      = "")
+    {
+        return w_function("RANK", "", partition, order, desc, as);
+    }
+
+    SqlWindowFunction& rank(
+        const sql::column& partition = sql::column()
+        , const sql::column& order   = sql::column()
+        , const bool& desc           = false
+        , const std::string& as      = "")
+    {
+        return w_function("RANK",  "", partition.str(), order.str(), desc, as);
+    }
+
+    virtual   std::string  str() const override
+    {
+        return std::string(_sql_func);
+    }
+
+private:
+
+    SqlWindowFunction& w_function(const std::string&  function_name,
+                                  std::string_view column
+                                  , std::string_view partition = ""
+                                  , std::string_view order_by  = ""
+                                  , const  bool desc             =  false
+                                  , const std::string& as        = "")
+    {
+        _sql_func.clear();
+
+        _sql_func.append(function_name);
+
+        _sql_func.append("(");
+
+        if (!column.empty() || (column.length() > 2))
+            _sql_func.append(column);
+
+        _sql_func.append(")");
+        _sql_func.append(" OVER ");
+        _sql_func.append("(");
+
+
+        if (partition.length() > 2)
+        {
+            _sql_func.append("PARTITION BY ");
+            _sql_func.append(partition);
+
+            _sql_func.append(" ");
+        }
+
+        if  (order_by.length() > 2)
+        {
+            _sql_func.append("ORDER BY ");
+            _sql_func.append(order_by);
+            _sql_func.append(" ");
+            desc ? _sql_func.append(" DESC ")
+                 : _sql_func.append(" ASC ");
+            _sql_func.append(" ) ");
+        }
+
+        if  (!as.empty())
+            _sql_func.append(" AS ").append(as);
+
+        return *this;
+    }
+
+    SqlWindowFunction& w_function(const std::string&  function_name,
+                                  std::string_view column
+                                  ,
+                                  std::string_view partition = ""
+                                  ,
+                                  const std::vector<std::pair<std::string, bool>> order_by_desc = std::vector<std::pair<std::string, bool>>
+                                                                                                  ()
+                                  ,
+                                  const std::string& as = "")
+    {
         _sql_func.clear();
-        _sql_func.append("COUNT(" + column.str() + ") ");
+        _sql_func.append(function_name);
+
+        _sql_func.append("(");
+
+        if (!column.empty() || (column.length() > 2))
+            _sql_func.append(column);
+
+        _sql_func.append(")");
+        _sql_func.append(" OVER ");
+        _sql_func.append("(");
+
+
+        if (partition.length() > 2)
+        {
+            _sql_func.append("PARTITION BY ");
+            _sql_func.append(partition);
+
+            _sql_func.append(" ");
+        }
+
+        if (order_by_desc.size() > 0)
+        {
+            _sql_func.append("ORDER BY ");
+
+            for (int i  = 0; i  < order_by_desc.size(); i++)
+            {
+                if  (order_by_desc.at(i).first.length() > 2)
+                {
+                    _sql_func.append(order_by_desc.at(i).first);
+                    _sql_func.append(" ");
+                    order_by_desc.at(i).second ? _sql_func.append(" DESC , ")
+                                               : _sql_func.append(" ASC , ");
+                }
+            }
+            _sql_func.resize(_sql_func.size() - 3);
+
+            _sql_func.append(" ) ");
+        }
+
+        if  (!as.empty())
+            _sql_func.append(" AS ").append(as);
+
+        return *this;
+    }
+};
+
+class TimeFormatingFunction : public SqlFunction
+{
+public:
+    TimeFormatingFunction(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        SqlFunction(resource) {}
+    virtual ~TimeFormatingFunction() {}
+
+
+    TimeFormatingFunction& to_timestamp(const column& data)
+    {
+        return t_function("to_timestamp", data);
+    }
+
+    virtual   std::string  str() const override
+    {
+        return std::string(_sql_func);
+    }
+
+private:
+    TimeFormatingFunction& t_function(const std::string& name, const column& data)
+    {
+        _sql_func.append(name).append("(").append(data.view()).append(")");
+        return *this;
+    }
+};
+
+class CastFunction : public SqlFunction
+{
+public:
+    CastFunction(const column& expression,
+
+                 const  std::string& data_type = "",
+                 const int& length = 30,
+                 std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        SqlFunction(resource)
+    {
+        _sql_func = "CAST(";
+        _sql_func.append(expression.view()).append(" AS ").append(data_type).append(") ");
+    }
+
+    std::string str() const override
+    {
+        return std::string(_sql_func);
+    }
+};
+
+
+
+
+class RoundFunction : public SqlFunction
+{
+public:
+    RoundFunction(const CastFunction& expression,
+                  const std::string& as = "",
+                  const int& length = 30,
+                  std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        SqlFunction(resource)
+    {
+        _sql_func = "ROUND(";
+        _sql_func.append(expression.str()).append(" , ");
+        append_value(_sql_func, length);
+        _sql_func.append(") ");
+
+        if (!as.empty())
+            _sql_func.append(" AS ").append(as);
+    }
+
+    RoundFunction(const column& expression,
+                  const std::string& as = "",
+                  const int& length = 30,
+                  std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        SqlFunction(resource)
+    {
+        _sql_func = "ROUND(";
+        _sql_func.append(expression.view()).append(" , ");
+        append_value(_sql_func, length);
+        _sql_func.append(") ");
+
+        if (!as.empty())
+            _sql_func.append(" AS ").append(as);
+    }
+
+    std::string str() const override
+    {
+        return std::string(_sql_func);
+    }
+};
+
+
+
+class DataTypeFormatingFunction : public SqlFunction
+{
+public:
+    DataTypeFormatingFunction(const std::string& as = "",
+                              std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        SqlFunction(resource),
+        _as(resource)
+    {
+        if (!as.empty())
+        {
+            _as.append(" AS ");
+            append_quoted(_as, as);
+        }
+    }
+
+    std::string str() const override
+    {
+        std::string str(_sql_func);
+
+        str.append(_as);
+        return str;
+    }
+
+    virtual ~DataTypeFormatingFunction() {}
+
+
+    DataTypeFormatingFunction& to_char(const sql::TimeFormatingFunction& tf_func,
+                                       const bool& is_text,
+                                       const  std::string& format = "")
+    {
+        DataTypeFormatingFunction& text = dtf_function("to_char", tf_func.str(), is_text, format);
+
+
+        return text;
+    }
+
+    DataTypeFormatingFunction& to_char(const column& data,
+                                       const std::string& format = "")
+    {
+        return dtf_function("to_char", data.str(), true, format);
+    }
+
+    DataTypeFormatingFunction& to_char(const column_value& data,
+                                       const std::string& format = "")
+    {
+        return dtf_function("to_char", data.str(), false, format);
+    }
+
+private:
+    DataTypeFormatingFunction& dtf_function(const std::string& name,
+                                            std::string_view data,
+                                            const bool& is_column,
+                                            const  std::string& format = "")
+    {
+        _sql_func.append(name);
+
+        _sql_func.append("(");
+        _sql_func.append(data);
+
+        if (!format.empty())
+            _sql_func.append(", '").append(format).append("'");
+        _sql_func.append(")");
+        return *this;
+    }
+
+    std::pmr::string _as;
+};
+
+
+
+
+class conditional_expressions : public SqlFunction
+{
+public:
+    conditional_expressions(const std::string& as = "",
+                            std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        SqlFunction(resource),
+        _as(resource)
+    {
+        _sql_func.append(" COALESCE ( ");
+
+        if (!as.empty())
+            _as.append(" AS ").append(as);
+    }
+
+    virtual  std::string str() const override
+    {
+        std::string str(_sql_func);
+
+        str.append(_as);
+        return str;
+    }
+
+    virtual  ~conditional_expressions() {}
+
+    template<typename T, typename ... Args>
+    conditional_expressions& coalesce(const T& col, Args&& ... cols)
+    {
+        _sql_func.append(to_value(col));
+        _sql_func.append(" , ");
+        coalesce(cols ...);
+        return *this;
+    }
+
+private:
+    conditional_expressions& coalesce()
+    {
+        // remove last comma
+        if (_sql_func.size() > 4)
+            _sql_func.resize(_sql_func.size() - 3);
+        _sql_func.append(" ) ");
+        return *this;
+    }
+
+    std::pmr::string _as;
+};
+
+#if __cplusplus >= 202002L
+// Text of a string literal as a template argument
+template<size_t N>
+struct fixed_string
+{
+    constexpr fixed_string(const char (&text)[N])
+    {
+        for (size_t i = 0; i < N; ++i)
+            data[i] = text[i];
+    }
+
+    // text of N - 1 characters
+    constexpr fixed_string(std::string_view text)
+    {
+        for (size_t i = 0; i + 1 < N; ++i)
+            data[i] = text[i];
+    }
+
+    constexpr size_t size() const
+    {
+        return N - 1;
+    }
+
+    constexpr std::string_view view() const
+    {
+        return std::string_view(data, N - 1);
+    }
+
+    char data[N] {};
+};
+
+enum class skeleton_clause
+{
+    none,
+    select,
+    from,
+    where,
+    order_by,
+    limit,
+    offset
+};
+
+// Statement of a fixed shape built at compile time: its text and the
+// positions of its S values, in the text format of SelectModel. Rendering
+// only writes the values between the static pieces.
+//
+//   constexpr auto by_age = static_select<"id", "name">()
+//       .from<"user">()
+//       .where<"age", ">">()
+//       .limit();
+//   std::string sql = by_age.render(18, 10);
+template<size_t N, size_t S, skeleton_clause Clause>
+class SqlSkeleton
+{
+public:
+    constexpr SqlSkeleton() {}
+
+    template<fixed_string ... Columns>
+    constexpr auto select() const requires (Clause == skeleton_clause::none)
+    {
+        constexpr size_t count = sizeof...(Columns);
+        SqlSkeleton<N + 8 + (0 + ... + (Columns.size() + 2)) + (count ? 2 * (count - 1) : 0), S, skeleton_clause::select> next(*this);
+        size_t i = 0;
+
+        next.put(" SELECT ");
+        ((next.put(i++ ? ", \"" : "\"").put(Columns.view()).put("\"")), ...);
+        return next;
+    }
+
+    template<fixed_string Table>
+    constexpr auto from() const requires (Clause == skeleton_clause::select)
+    {
+        SqlSkeleton<N + 9 + Table.size(), S, skeleton_clause::from> next(*this);
+
+        next.put(" FROM \"").put(Table.view()).put("\" ");
+        return next;
+    }
+
+    // table declared with SQL_TABLE
+    template<typename Table>
+    constexpr auto from() const requires (Clause == skeleton_clause::select)
+    {
+        return from<fixed_string<Table::sql_name.size() + 1>(Table::sql_name)>();
+    }
+
+    // "column" op value, terms are joined by AND
+    template<fixed_string Column, fixed_string Op = "=">
+    constexpr auto where() const requires (Clause == skeleton_clause::from || Clause == skeleton_clause::where)
+    {
+        constexpr bool first = Clause == skeleton_clause::from;
+        SqlSkeleton<N + (first ? 7 : 5) + Column.size() + Op.size() + 4, S + 1, skeleton_clause::where> next(*this);
+
+        next.put(first ? " WHERE " : " AND ").put("\"").put(Column.view()).put("\" ").put(Op.view()).put(" ").slot();
+        return next;
+    }
+
+    template<fixed_string Column, bool Desc = false>
+    constexpr auto order_by() const requires (Clause == skeleton_clause::from || Clause == skeleton_clause::where)
+    {
+        SqlSkeleton<N + 12 + Column.size() + (Desc ? 6 : 0), S, skeleton_clause::order_by> next(*this);
+
+        next.put(" ORDER BY \"").put(Column.view()).put("\"");
+
+        if (Desc)
+            next.put(" DESC ");
+        return next;
+    }
+
+    constexpr auto limit() const requires (Clause >= skeleton_clause::from && Clause < skeleton_clause::limit)
+    {
+        SqlSkeleton<N + 7, S + 1, skeleton_clause::limit> next(*this);
+
+        next.put(" limit ").slot();
+        return next;
+    }
+
+    constexpr auto offset() const requires (Clause == skeleton_clause::limit)
+    {
+        SqlSkeleton<N + 8, S + 1, skeleton_clause::offset> next(*this);
+
+        next.put(" offset ").slot();
+        return next;
+    }
+
+    // static text, without the values
+    constexpr std::string_view text() const
+    {
+        return std::string_view(_text, N);
+    }
+
+    static constexpr size_t slots()
+    {
+        return S;
+    }
+
+    // offset in text() value index goes to
+    constexpr size_t slot_position(size_t index) const
+    {
+        return _slots[index];
+    }
+
+    // writes the statement with one value per slot, inlined or bound as w does
+    template<typename ... Args>
+    void render_to(SqlWriter& w, const Args& ... values) const
+    {
+        static_assert(sizeof...(Args) == S, "one value per slot");
+        size_t position = 0;
+        size_t index    = 0;
+
+        ((w.append(_text + position, _slots[index] - position), w.value(values), position = _slots[index++]), ...);
+        w.append(_text + position, N - position);
+    }
+
+    template<typename ... Args>
+    size_t render_to(std::string& out, SqlBinds& binds, const Args& ... values) const
+    {
+        SqlWriter w(out, binds);
+
+        render_to(w, values ...);
+        return w.size();
+    }
+
+    template<typename ... Args>
+    std::string render(const Args& ... values) const
+    {
+        std::string out;
+        SqlWriter w(out);
+
+        render_to(w, values ...);
+        return out;
+    }
+
+private:
+    template<size_t, size_t, skeleton_clause>
+    friend class SqlSkeleton;
+
+    template<size_t M, size_t T, skeleton_clause C>
+    constexpr SqlSkeleton(const SqlSkeleton<M, T, C>& prefix) :
+        _length(M)
+    {
+        for (size_t i = 0; i < M; ++i)
+            _text[i] = prefix._text[i];
+
+        for (size_t i = 0; i < T; ++i)
+            _slots[i] = prefix._slots[i];
+    }
+
+    constexpr SqlSkeleton& put(std::string_view piece)
+    {
+        for (char c : piece)
+            _text[_length++] = c;
+        return *this;
+    }
+
+    constexpr SqlSkeleton& slot()
+    {
+        _slots[S - 1] = _length;
+        return *this;
+    }
+
+    char _text[N + 1] {};
+    size_t _slots[S + 1] {};
+    size_t _length = 0;
+};
+
+template<fixed_string ... Columns>
+constexpr auto static_select()
+{
+    return SqlSkeleton<0, 0, skeleton_clause::none>().template select<Columns ...>();
+}
+
+// columns declared with SQL_COLUMN
+template<typename ... Columns>
+constexpr auto static_select() requires (sizeof...(Columns) > 0)
+{
+    return static_select<fixed_string<Columns::sql_name.size() + 1>(Columns::sql_name) ...>();
+}
+#endif
+
+// Bounds of each statement when a model is split, 0 is unbounded. A row
+// larger than max_bytes still gets a statement of its own.
+struct chunk_limits
+{
+    size_t max_rows    = 0;  // rows of a multi-row insert or bulk update
+    size_t max_params  = 0;  // values per statement, 65535 for postgres
+    size_t max_bytes   = 0;
+    size_t max_in_list = 0;  // elements of an in-list
+};
+
+class SqlModel
+{
+public:
+    SqlModel() {}
+    SqlModel(const SqlModel& data) = default;
+    SqlModel(SqlModel&& data)      = default;
+    virtual ~SqlModel() {}
+
+    // writes the statement to w; models must not change state while rendering
+    virtual void render(SqlWriter& w) const = 0;
+
+    virtual const std::string& str()
+    {
+        _sql.clear();
+        render_to(_sql);
+        return _sql;
+    }
+
+    // the statement of a const model, safe to call from many threads at once
+    std::string str() const
+    {
+        std::string sql;
+
+        render_to(sql);
+        return sql;
+    }
+
+    // 64-bit hash of the shape of the statement: its keywords, identifiers
+    // and placeholders, with every literal value reduced to its position and
+    // every in-list to one item. Statements that differ only in their values
+    // share it. Text given verbatim, as to where(std::string), is hashed as
+    // it is. Called on its own it costs a render pass that writes nothing;
+    // render_to(out, fingerprint) gets it from the render of the statement.
+    virtual uint64_t fingerprint() const
+    {
+        uint64_t hash = fnv_offset;
+        SqlWriter w(hash);
+
+        render(w);
+        return hash;
+    }
+
+    // result of the last non-const str()
+    const std::string& last_sql()
+    {
+        return _sql;
+    }
+
+    // length in bytes of the statement render() produces
+    size_t exact_size() const
+    {
+        SqlWriter w;
+
+        render(w);
+        return w.size();
+    }
+
+    // appends the statement to out with a single reallocation at most
+    size_t render_to(std::string& out) const
+    {
+        size_t size = exact_size();
+
+        out.reserve(out.size() + size);
+        SqlWriter w(out);
+        render(w);
+        return size;
+    }
+
+    size_t render_to(std::pmr::string& out) const
+    {
+        size_t size = exact_size();
+
+        out.reserve(out.size() + size);
+        SqlWriter w(out);
+        render(w);
+        return size;
+    }
+
+    // appends the statement to out and sets fingerprint to its fingerprint()
+    // in the same pass
+    size_t render_to(std::string& out, uint64_t& fingerprint) const
+    {
+        size_t size = exact_size();
+
+        out.reserve(out.size() + size);
+        fingerprint = render_hashed(out);
+        return size;
+    }
+
+    // writes the statement to buffer without a terminating null, returns its
+    // length; nothing is written when the length exceeds buffer_size
+    size_t render_to(char* buffer, size_t buffer_size) const
+    {
+        size_t size = exact_size();
+
+        if (size > buffer_size)
+            return size;
+        SqlWriter w(buffer);
+        render(w);
+        return size;
+    }
+
+    // streams the statement without materializing it, returns its length
+    size_t render_to(SqlSink& sink) const
+    {
+        SqlWriter w(sink);
+
+        render(w);
+        sink.flush();
+        return w.size();
+    }
+
+    // renders the statement once per max_in_list elements of its first in-list
+    // that is longer, calls f(const std::string&) for each, returns the number
+    // of statements. Only " in (" lists are split; the statements together
+    // match the rows the whole list would as long as the list is a term of
+    // the top-level AND of the condition.
+    template<typename F>
+    size_t for_each_chunk(const chunk_limits& limits, F&& f) const
+    {
+        std::string sql;
+        size_t chunk = 0;
+        size_t items = 0;
+
+        do
+        {
+            sql.clear();
+            SqlWriter w(sql);
+
+            w.split_lists(limits.max_in_list, chunk++);
+            render(w);
+            f(sql);
+            items = w.split_items();
+        }
+        while (chunk * limits.max_in_list < items);
+        return chunk;
+    }
+
+    std::vector<std::string> chunks(const chunk_limits& limits) const
+    {
+        std::vector<std::string> statements;
+
+        for_each_chunk(limits, [&statements](const std::string& sql) {
+            statements.push_back(sql);
+        });
+        return statements;
+    }
+
+    // appends the statement with a placeholder in place of each literal and
+    // appends the literals to binds.values, returns the length of the
+    // statement. A Param, including the " ? " of insert(c), throws
+    // std::logic_error: it has no value to bind, and its text would collide
+    // with the numbered placeholders.
+    size_t render_to(std::string& out, SqlBinds& binds) const
+    {
+        SqlWriter w(out, binds);
+
+        render(w);
+        return w.size();
+    }
+
+protected:
+    // gives every column of the model an arena of its own, see freeze()
+    virtual void detach() {}
+
+    // appends the statement to out, returns its fingerprint()
+    virtual uint64_t render_hashed(std::string& out) const
+    {
+        uint64_t hash = fnv_offset;
+        SqlWriter w(out, hash);
+
+        render(w);
+        return hash;
+    }
+
+    template<typename M>
+    friend std::shared_ptr<const std::decay_t<M>> freeze(M&& model, std::pmr::memory_resource* resource);
+
+private:
+    //  SqlModel(const SqlModel& m)               = delete;
+    SqlModel& operator=(const SqlModel& data) = delete;
+
+protected:
+    std::string _sql;
+};
+
+// Immutable copy of a model that shares no nodes with the model or the
+// columns it was built from. Any number of threads may render it at once
+// through its const members while the original keeps changing. A temporary
+// model is moved in and keeps its nodes.
+template<typename M>
+std::shared_ptr<const std::decay_t<M>> freeze(M&& model, std::pmr::memory_resource* resource)
+{
+    using model_type = std::decay_t<M>;
+
+    std::shared_ptr<model_type> frozen =
+        std::allocate_shared<model_type>(std::pmr::polymorphic_allocator<model_type>(resource), std::forward<M>(model));
+
+    static_cast<SqlModel&>(*frozen).detach();
+    return frozen;
+}
+
+inline void expression::render_leaf(SqlWriter& w, const expr_node& n) const
+{
+    switch (n.kind)
+    {
+    case expr_kind::literal:
+        w.literal(text(n), n.type);
+        break;
+
+    case expr_kind::param:
+        w.param(text(n));
+        break;
+
+    case expr_kind::subquery:
+        _models[n.count]->render(w);
+        break;
+
+    default:
+        w.append(text(n));
+        break;
+    }
+}
+
+// A model compiled once into its static text plus one slot per literal or
+// Param it renders. render() splices new values into the slots, so repeated
+// queries of the same shape skip the builder and the clause rendering.
+class SqlTemplate
+{
+public:
+    SqlTemplate(const SqlModel& model)
+    {
+        SqlWriter w(_text, *this);
+
+        model.render(w);
+    }
+
+    size_t slots() const
+    {
+        return _slots.size();
+    }
+
+    // text the slot was compiled with
+    const std::string& slot_value(size_t index) const
+    {
+        return _slots[index].value;
+    }
+
+    bool is_param(size_t index) const
+    {
+        return _slots[index].is_param;
+    }
+
+    // type of the literal compiled into the slot, null for params and nulls,
+    // which take a value of any type
+    literal_type slot_type(size_t index) const
+    {
+        return _slots[index].type;
+    }
+
+    // binds values to the first slots in order, the remaining slots keep the
+    // values the template was compiled with. More values than slots, or a
+    // value of another type than its slot, throw std::invalid_argument; an
+    // integer fits a real slot, a null or a Param fits any
+    template<typename ... Args>
+    std::string render(const Args& ... values) const
+    {
+        std::string out;
+
+        render_to(out, values ...);
+        return out;
+    }
+
+    template<typename ... Args>
+    size_t render_to(std::string& out, const Args& ... values) const
+    {
+        if (sizeof...(Args) > _slots.size())
+            throw std::invalid_argument("sql: more values than template slots");
+
+        size_t i = 0;
+
+        if (!(fits(_slots[i++].type, value_type<Args>()) && ... && true))
+            throw std::invalid_argument("sql: value of another type than its template slot");
+
+        size_t start    = out.size();
+        size_t position = 0;
+
+        out.reserve(start + _text.size() + _values_size);
+        i = 0;
+        ((out.append(_text, position, _slots[i].position - position),
+          append_slot_value(out, values),
+          position = _slots[i++].position), ...);
+
+        for (; i < _slots.size(); ++i)
+        {
+            out.append(_text, position, _slots[i].position - position);
+            out.append(_slots[i].value);
+            position = _slots[i].position;
+        }
+        out.append(_text, position, std::string::npos);
+        return out.size() - start;
+    }
+
+private:
+    friend class SqlWriter;
+
+    void add_slot(std::string value, literal_type type, bool is_param)
+    {
+        _values_size += value.size();
+        _slots.push_back({_text.size(), type, is_param, std::move(value)});
+    }
+
+    // bools as the models write them, TRUE and FALSE, which a boolean
+    // column takes where it does not take 1 and 0
+    template<typename T>
+    static void append_slot_value(std::string& out, const T& data)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+            out.append(data ? "TRUE" : "FALSE");
+        else
+            append_value(out, data);
+    }
+
+    template<typename T>
+    static constexpr literal_type value_type()
+    {
+        return std::is_same<T, Param>::value ? literal_type::null : literal_type_of<T>();
+    }
+
+    static bool fits(literal_type slot, literal_type value)
+    {
+        return slot == value || slot == literal_type::null || value == literal_type::null ||
+               (slot == literal_type::real && value == literal_type::integer);
+    }
+
+    struct slot
+    {
+        size_t position;  // offset in _text the value goes to
+        literal_type type;
+        bool is_param;
+        std::string value;
+    };
+
+    std::string _text;
+    std::vector<slot> _slots;
+    size_t _values_size = 0;  // of the compiled slot values
+};
+
+inline void SqlWriter::literal(std::string_view text, literal_type type)
+{
+    const uint32_t unhashed = _unhashed;
+
+    if (_fingerprint)
+    {
+        // the position of a value, not its text
+        if (!writes())
+        {
+            append("?", 1);
+            return;
+        }
+
+        if (!unhashed)
+            *_fingerprint = fnv1a(*_fingerprint, "?", 1);
+        ++_unhashed;
+    }
+
+    if (_binds)
+    {
+        if (_binds->style == placeholder_style::question)
+        {
+            append("?", 1);
+        }
+        else
+        {
+            char number[24] = "$";
+            char* end = std::to_chars(number + 1, number + sizeof(number), _binds->values.size() + 1).ptr;
+
+            append(number, end - number);
+        }
+        _binds->values.push_back({type, std::string(text)});
+    }
+    else if (type == literal_type::text)
+    {
+        if (_template)
+        {
+            std::string quoted("'");
+
+            append_escaped(quoted, text);
+            quoted.append("'");
+            _template->add_slot(std::move(quoted), type, false);
+        }
+        else
+        {
+            append("'", 1);
+            append_escaped(*this, text);
+            append("'", 1);
+        }
+    }
+    else if (_template)
+    {
+        _template->add_slot(std::string(text), type, false);
+    }
+    else
+    {
+        append(text);
+    }
+    _unhashed = unhashed;
+}
+
+inline void SqlWriter::param(std::string_view text)
+{
+    if (_binds)
+        throw std::logic_error("sql: Param in a statement rendered with binds");
+
+    if (_template)
+        _template->add_slot(std::string(text), literal_type::null, true);
+    else
+        append(text);
+}
+
+enum class nulls_order : uint8_t
+{
+    unspecified,
+    first,
+    last
+};
+
+// column of a multi-column ORDER BY, and of the key of keyset pagination
+struct sort_key
+{
+    std::string name;  // column, or table.column with the table as written
+
+    bool desc         = false;
+    nulls_order nulls = nulls_order::unspecified;
+};
+
+class SelectModel : public SqlModel
+{
+public:
+    SelectModel(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _select_columns(resource),
+        _distinct(false),
+        _groupby_columns(resource),
+        _table_name(resource),
+        _join_type(resource),
+        _where_condition(resource),
+        _having_condition(resource),
+        _order_by(resource),
+        _order_keys(resource),
+        _seek(resource),
+        _limit(resource),
+        _offset(resource),
+        _clause_text(clause_count, resource) {}
+    SelectModel(const SelectModel& data) = default;
+
+    // the source is left empty, with a clause cache to render it again
+    SelectModel(SelectModel&& data) :
+        SqlModel(std::move(data)),
+        _select_columns(std::move(data._select_columns)),
+        _distinct(data._distinct),
+        _groupby_columns(std::move(data._groupby_columns)),
+        _table_name(std::move(data._table_name)),
+        _join_type(std::move(data._join_type)),
+        _where_condition(std::move(data._where_condition)),
+        _having_condition(std::move(data._having_condition)),
+        _order_by(std::move(data._order_by)),
+        _order_by_desc(data._order_by_desc),
+        _order_keys(std::move(data._order_keys)),
+        _seek(std::move(data._seek)),
+        _limit(std::move(data._limit)),
+        _offset(std::move(data._offset)),
+        _clause_text(std::move(data._clause_text)),
+        _dirty(data._dirty),
+        _hash_dirty(data._hash_dirty)
+    {
+        std::copy(data._clause_hash, data._clause_hash + clause_count, _clause_hash);
+        data.reset();
+    }
+
+    virtual ~SelectModel() {}
+
+    SelectModel& operator=(SelectModel&& data)
+    {
+        if (this == &data)
+            return *this;
+        _sql              = std::move(data._sql);
+        _select_columns   = std::move(data._select_columns);
+        _distinct         = data._distinct;
+        _groupby_columns  = std::move(data._groupby_columns);
+        _table_name       = std::move(data._table_name);
+        _join_type        = std::move(data._join_type);
+        _where_condition  = std::move(data._where_condition);
+        _having_condition = std::move(data._having_condition);
+        _order_by         = std::move(data._order_by);
+        _order_by_desc    = data._order_by_desc;
+        _order_keys       = std::move(data._order_keys);
+        _seek             = std::move(data._seek);
+        _limit            = std::move(data._limit);
+        _offset           = std::move(data._offset);
+        _clause_text      = std::move(data._clause_text);
+        _dirty            = data._dirty;
+        _hash_dirty       = data._hash_dirty;
+        std::copy(data._clause_hash, data._clause_hash + clause_count, _clause_hash);
+        data.reset();
+        return *this;
+    }
+
+    template<typename ... Args>
+    SelectModel& select(const std::string& str, Args&& ... columns)
+    {
+        _select_columns.emplace_back(resource())(str);
+        select(std::forward<Args>(columns) ...);
+        touch(select_clause);
+        return *this;
+    }
+
+    template<typename ... Args>
+    SelectModel& select(const SqlFunction& sql_function, Args&& ... columns)
+    {
+        _select_columns.push_back(column::raw(sql_function.str(), resource()));
+        select(columns ...);
+        touch(select_clause);
+        return *this;
+    }
+
+    template<typename ... Args>
+    SelectModel& select(std::pair<SelectModel, std::string> subquery, Args&& ... columns)
+    {
+        column& pb = _select_columns.emplace_back(resource());
+
+        pb.concat(" ( ");
+        pb.concat(shared(std::move(subquery.first)));
+        pb.concat(" ) ");
+
+        if (!subquery.second.empty())
+        {
+            std::pmr::string alias(" AS ", resource());
+
+            alias.append(subquery.second);
+            pb.concat(alias);
+        }
+
+        select(std::forward<Args>(columns) ...);
+        touch(select_clause);
+        return *this;
+    }
+
+    template<typename ... Args>
+    SelectModel& select(column column_struct, Args&& ... columns)
+    {
+        _select_columns.push_back(std::move(column_struct));
+        select(std::forward<Args>(columns) ...);
+        touch(select_clause);
+        return *this;
+    }
+
+    template<typename ... Args>
+    SelectModel& select(const column_value& data, Args&& ... columns)
+    {
+        _select_columns.push_back(column::raw(data.view(), resource()));
+        select(std::forward<Args>(columns) ...);
+        touch(select_clause);
+        return *this;
+    }
+
+    // for recursion
+    SelectModel& select()
+    {
+        return *this;
+    }
+
+    // projection of declared columns, or of the sql_columns of result types
+    template<typename ... Columns>
+    SelectModel& select()
+    {
+        (select_projection(typename projection_of<Columns>::type()), ...);
+        touch(select_clause);
+        return *this;
+    }
+
+    SelectModel& distinct()
+    {
+        _distinct = true;
+        touch(select_clause);
+        return *this;
+    }
+
+    // template<typename ... Args>
+    SelectModel& from(const std::string& table_name, const std::string& tablespace = "", const std::string& alias = "")
+    {
+        return from_table(table_name, tablespace, alias);
+    }
+
+    SelectModel& from(const ident& table_name, const std::string& alias = "")
+    {
+        return from_table(table_name, "", alias);
+    }
+
+    // table declared with SQL_TABLE
+    template<typename Table>
+    SelectModel& from(const std::string& alias = "")
+    {
+        std::pmr::string from(Table::sql_quoted, resource());
+
+        if (!alias.empty())
+            from.append(" ").append(alias).append(" ");
+        else
+            from.append(" ");
+
+        _table_name.concat(from);
+        touch(from_clause);
+        return *this;
+    }
+
+    SelectModel& from_subquery(const std::string& table_name, const std::string& alias = "")
+    {
+        std::pmr::string from(table_name, resource());
+
+        if (!alias.empty())
+            from.append(" ").append(alias).append(" ");
+        else
+            from.append(" ");
+
+        _table_name.concat(from);
+        touch(from_clause);
+        return *this;
+    }
+
+    // name is a string, quoted here, or an interned ident
+    template<typename Name>
+    SelectModel& from_table(const Name& table_name, const std::string& tablespace, const std::string& alias)
+    {
+        std::pmr::string from(resource());
+
+        if (!tablespace.empty())
+        {
+            from.append(tablespace);
+            from.append(".");
+        }
+        append_quoted(from, table_name);
+
+        if (!alias.empty())
+            from.append(" ").append(alias).append(" ");
+        else
+            from.append(" ");
+
+        _table_name.concat(from);
+        touch(from_clause);
+        return *this;
+    }
+
+    SelectModel& from(std::vector<SelectModel> selects,  const std::string& alias = "")
+    {
+        for (size_t i = 0; i < selects.size(); i++)
+        {
+            _table_name.concat(" ( ");
+            _table_name.concat(shared(std::move(selects[i])));
+            _table_name.concat(" )");
+
+            if (i != selects.size())
+                _table_name.concat(" UNION ALL ");
+        }
+
+        if (!alias.empty())
+        {
+            std::pmr::string from(" ", resource());
+
+            from.append(alias).append(" ");
+            _table_name.concat(from);
+        }
+        else
+        {
+            _table_name.concat(" ");
+        }
+        touch(from_clause);
+        return *this;
+    }
+
+    SelectModel& join_statement(const std::string& join_type,
+                                const std::string& table_name,
+                                const std::string& tablespace,
+                                const std::string& alias,
+                                const std::string& on_conditions)
+    {
+        return join_statement(join_type, table_name, tablespace, alias,
+                              column::raw(on_conditions, _join_type.get_allocator().resource()));
+    }
+
+    // table_name is a string, quoted here, or an interned ident
+    template<typename Name>
+    SelectModel& join_statement(const std::string& join_type,
+                                const Name& table_name,
+                                const std::string& tablespace,
+                                const std::string& alias,
+                                column on_conditions)
+    {
+        //        std::vector<std::pair<std::string, std::vector<std::string>>> type;
+
+        std::pmr::string& join_type_and_table = _join_type.emplace_back(std::piecewise_construct,
+                                                                        std::forward_as_tuple(" "),
+                                                                        std::forward_as_tuple(std::move(on_conditions))).first;
+
+        join_type_and_table.append(join_type).append(" ");
+
+        if (!tablespace.empty())
+            join_type_and_table.append(tablespace).append(".");
+
+        append_quoted(join_type_and_table, table_name);
+
+        if (!alias.empty())
+            join_type_and_table.append(" ").append(alias).append(" ");
+
+        join_type_and_table.append("ON ");
+
+        touch(join_clause);
+        return *this;
+    }
+
+    template<typename Name>
+    SelectModel& left_join(const Name& table_name,
+                           column on_conditions,
+                           const std::string& tablespace = "",
+                           const std::string& alias      = ""
+                           )
+    {
+        join_statement("LEFT JOIN", table_name, tablespace, alias, std::move(on_conditions));
+
+        return *this;
+    }
+
+    template<typename Name>
+    SelectModel& left_outer_join(const Name& table_name,
+                                 column on_conditions,
+                                 const std::string& tablespace = "",
+                                 const std::string& alias      = "")
+    {
+        join_statement("left outer join", table_name, tablespace, alias, std::move(on_conditions));
+
+        return *this;
+    }
+
+    template<typename Name>
+    SelectModel& right_join(const Name& table_name,
+                            column on_conditions,
+                            const std::string& tablespace = "",
+                            const std::string& alias      = ""
+                            )
+    {
+        join_statement(" right join ", table_name, tablespace, alias, std::move(on_conditions));
+        return *this;
+    }
+
+    template<typename Name>
+    SelectModel& right_outer_join(const Name& table_name,
+                                  column on_conditions,
+                                  const std::string& tablespace = "",
+                                  const std::string& alias      = "")
+    {
+        join_statement(" RIGHT OUTER JOIN ", table_name, tablespace, alias, std::move(on_conditions));
+        return *this;
+    }
+
+    template<typename Name>
+    SelectModel& full_join(const Name& table_name,
+                           column on_conditions,
+                           const std::string& tablespace = "",
+                           const std::string& alias      = "")
+    {
+        join_statement(" full join ", table_name, tablespace, alias, std::move(on_conditions));
+        return *this;
+    }
 
+    template<typename Name>
+    SelectModel& full_outer_join(const Name& table_name,
+                                 column on_conditions,
+                                 const std::string& tablespace = "",
+                                 const std::string& alias      = "")
+    {
+        join_statement(" FULL OUTER JOIN ", table_name, tablespace, alias, std::move(on_conditions));
         return *this;
     }
 
-    SqlWindowFunction& dense_rank(
-        const std::string& partition = ""
-        , const std::string& order   = ""
-        , const bool& desc           = false
-        , const std::string& as      = "")
+    SelectModel& where(const std::string& condition)
     {
-        return w_function("DENSE_RANK", "", partition, order, desc, as);
+        _where_condition.push_back(column::raw(condition, _where_condition.get_allocator().resource()));
+        touch(where_clause);
+        return *this;
     }
 
-    SqlWindowFunction& dense_rank(
-        const sql::column& partition = sql::column()
-        , const sql::column& order   = sql::column()
-        , const bool& desc           = false
-        , const std::string& as      = "")
+    SelectModel& where(column condition)
     {
-        return w_function("DENSE_RANK",  "", partition.str(), order.str(), desc, as);
+        _where_condition.push_back(std::move(condition));
+        touch(where_clause);
+        return *this;
     }
 
-    SqlWindowFunction& dense_rank(
-        const sql::column& partition                                    = sql::column()
-        , const std::vector<std::pair<sql::column, bool>> order_by_desc = std::vector<std::pair<sql::column, bool>>
-                                                                          ()
-        , const std::string& as = "")
+    SelectModel& where(const  column_value& condition)
     {
-        std::vector<std::pair<std::string, bool>> order_by_desc_string;
+        _where_condition.push_back(column::raw(condition.view(), _where_condition.get_allocator().resource()));
+        touch(where_clause);
+        return *this;
+    }
 
-        for (int i = 0; i < order_by_desc.size(); i++)
+    SelectModel& where_exists(std::vector<SelectModel> data)
+    {
+        column& where_c = _where_condition.emplace_back(resource());
+
+        for (size_t i = 0; i < data.size(); i++)
         {
-            order_by_desc_string.push_back(std::pair(order_by_desc.at(i).first.str(), order_by_desc.at(i).second));
+            if (i > 0)
+                where_c.concat("OR ");
+            where_c.concat("(EXISTS (");
+            where_c.concat(shared(std::move(data[i])));
+            where_c.concat(" ) ) ");
         }
+        touch(where_clause);
+        return *this;
+    }
 
-        // const std::vector<std::pair<std::string, bool>> const_order_by_desc_string = order_by_desc_string;
-        return w_function("DENSE_RANK", "", partition.str(), order_by_desc_string, as);
+    SelectModel& where_not_exists(std::vector<SelectModel> data)
+    {
+        column& where_c = _where_condition.emplace_back(resource());
+
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            if (i > 0)
+                where_c.concat("OR ");
+            where_c.concat("( NOT EXISTS (");
+            where_c.concat(shared(std::move(data[i])));
+            where_c.concat(" ) )  ");
+        }
+        touch(where_clause);
+        return *this;
     }
 
-    SqlWindowFunction& dense_rank(
-        const std::string& partition                                    = std::string()
-        , const std::vector<std::pair<std::string, bool>> order_by_desc = std::vector<std::pair<std::string, bool>>
-                                                                          ()
-        , const std::string& as = "")
+    template<typename T>
+    SelectModel& where_between(const  column& cond, const T& begin_val, const  T& end_val)
     {
-        return w_function("DENSE_RANK", "", partition, order_by_desc, as);
+        _where_condition.push_back(cond);
+        _where_condition.back().between(begin_val, end_val);
+        touch(where_clause);
+        return *this;
     }
 
-    SqlWindowFunction& rank(
-        const std::string& partition = ""
-        , const std::string& order   = ""
-        , const bool& desc           = false
-        , const std::string& as      = "")
+    template<typename ... Args>
+    SelectModel& group_by(const std::string& str, Args&& ... columns)
     {
-        return w_function("RANK", "", partition, order, desc, as);
+        _groupby_columns.emplace_back(str);
+        group_by(columns ...);
+        touch(group_by_clause);
+        return *this;
     }
 
-    SqlWindowFunction& rank(
-        const sql::column& partition = sql::column()
-        , const sql::column& order   = sql::column()
-        , const bool& desc           = false
-        , const std::string& as      = "")
+    // for recursion
+    SelectModel& group_by()
     {
-        return w_function("RANK",  "", partition.str(), order.str(), desc, as);
+        return *this;
     }
 
-    virtual   std::string  str() const override
+    SelectModel& having(const std::string& condition)
     {
-        return _sql_func;
+        _having_condition.push_back(column::raw(condition, _having_condition.get_allocator().resource()));
+        touch(having_clause);
+        return *this;
     }
 
-private:
+    SelectModel& having(column condition)
+    {
+        _having_condition.push_back(std::move(condition));
+        touch(having_clause);
+        return *this;
+    }
 
-    SqlWindowFunction& w_function(const std::string&  function_name,
-                                  const std::string& column
-                                  , const std::string& partition = ""
-                                  , const std::string& order_by  = ""
-                                  , const  bool desc             =  false
-                                  , const std::string& as        = "")
+    SelectModel& order_by(const std::string& order_by,  const bool desc = false)
     {
-        _sql_func.clear();
+        _order_by      = order_by;
+        _order_by_desc = desc;
+        drop_keys();
+        touch(order_by_clause);
+        return *this;
+    }
 
-        _sql_func.append(function_name);
+    SelectModel& order_by(const column& order_by,  const bool desc = false)
+    {
+        _order_by      = order_by.view();
+        _order_by_desc = desc;
+        drop_keys();
+        touch(order_by_clause);
+        return *this;
+    }
 
-        _sql_func.append("(");
+    // ORDER BY over several columns, in the order of the index that serves
+    // it; the keys are also those of seek_after()
+    SelectModel& order_by_keys(const std::vector<sort_key>& keys)
+    {
+        _order_by.clear();
+        _order_by_desc = false;
+        _order_keys.clear();
 
-        if (!column.empty() || (column.length() > 2))
-            _sql_func.append(column);
+        for (const sort_key& key : keys)
+        {
+            if (!_order_by.empty())
+                _order_by.append(", ");
+            append_key(_order_by, key.name);
+
+            if (key.desc)
+                _order_by.append(" DESC");
+
+            if (key.nulls == nulls_order::first)
+                _order_by.append(" NULLS FIRST");
+            else if (key.nulls == nulls_order::last)
+                _order_by.append(" NULLS LAST");
+
+            std::pmr::string& name = _order_keys.emplace_back().first;
+
+            append_key(name, key.name);
+            _order_keys.back().second = key.desc;
+        }
+
+        _seek = column(resource());
+        touch(order_by_clause);
+        touch(where_clause);
+        return *this;
+    }
+
+    // keyset pagination: restricts the rows to those after the last row of
+    // the previous page, given its values of the order_by_keys() keys. Keys of one
+    // direction compare as a row value, ("a", "b") > (1, 2), which an index
+    // on (a, b) seeks to; mixed directions expand to ("a" > 1) OR ("a" = 1
+    // AND "b" < 2). Keys must not be null. Replaces the previous seek, without
+    // values the first page is selected; otherwise there is one value per key
+    // or std::invalid_argument is thrown.
+    template<typename ... Args>
+    SelectModel& seek_after(const Args& ... last_key)
+    {
+        const size_t count = sizeof...(Args);
+
+        if (count != 0 && count != _order_keys.size())
+            throw std::invalid_argument("sql: seek_after() needs one value per order_by_keys() key");
+
+        _seek = column(resource());
+        touch(where_clause);
+
+        if (count == 0)
+            return *this;
+
+        expression& e = _seek.expr();
+        uint32_t values[sizeof...(Args) + 1] = {e.add_literal(last_key)...};
+        bool same_direction = true;
+
+        for (size_t i = 1; i < count; ++i)
+            same_direction = same_direction && _order_keys[i].second == _order_keys[0].second;
+
+        if (same_direction)
+        {
+            _seek.concat("(");
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (i)
+                    _seek.concat(", ");
+                _seek.concat(e.add(expr_kind::identifier, _order_keys[i].first));
+            }
+            _seek.concat(_order_keys[0].second ? ") < (" : ") > (");
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (i)
+                    _seek.concat(", ");
+                _seek.concat(values[i]);
+            }
+            _seek.concat(")");
+            return *this;
+        }
+        _seek.concat("(");
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            _seek.concat(i ? " OR (" : "(");
+
+            for (size_t j = 0; j < i; ++j)
+            {
+                _seek.concat(e.add(expr_kind::identifier, _order_keys[j].first));
+                _seek.concat(" = ");
+                _seek.concat(values[j]);
+                _seek.concat(" AND ");
+            }
+            _seek.concat(e.add(expr_kind::identifier, _order_keys[i].first));
+            _seek.concat(_order_keys[i].second ? " < " : " > ");
+            _seek.concat(values[i]);
+            _seek.concat(")");
+        }
+        _seek.concat(")");
+        return *this;
+    }
+
+    template<typename T>
+    SelectModel& limit(const T& limit)
+    {
+        _limit.clear();
+        append_value(_limit, limit);
+        touch(tail_clause);
+        return *this;
+    }
+
+    template<typename T>
+    SelectModel& limit(const T& offset, const T& limit)
+    {
+        _offset.clear();
+        _limit.clear();
+        append_value(_offset, offset);
+        append_value(_limit, limit);
+        touch(tail_clause);
+        return *this;
+    }
+
+    template<typename T>
+    SelectModel& offset(const T& offset)
+    {
+        _offset.clear();
+        append_value(_offset, offset);
+        touch(tail_clause);
+        return *this;
+    }
+
+    virtual void render(SqlWriter& w) const override
+    {
+        for (int c = 0; c < clause_count; ++c)
+            render_clause(w, static_cast<clause>(c));
+    }
+
+    using SqlModel::str;
+
+    // re-renders only the clauses changed since the last call and splices
+    // them with the cached text of the others; each clause it renders is
+    // hashed for fingerprint() on the way
+    virtual const std::string& str() override
+    {
+        size_t size = 0;
+
+        // a moved-from model gave its cache away
+        _clause_text.resize(clause_count);
+        for (int c = 0; c < clause_count; ++c)
+        {
+            if (_dirty & (1u << c))
+            {
+                _clause_text[c].clear();
+                _clause_hash[c] = fnv_offset;
+                SqlWriter w(_clause_text[c], _clause_hash[c]);
+                render_clause(w, static_cast<clause>(c));
+            }
+            size += _clause_text[c].size();
+        }
+        _hash_dirty &= ~_dirty;
+        _dirty = 0;
+        _sql.clear();
+        _sql.reserve(size);
+
+        for (const std::pmr::string& text : _clause_text)
+            _sql.append(text);
+        return _sql;
+    }
+
+    // fingerprint of the clauses, each hashed apart
+    virtual uint64_t fingerprint() const override
+    {
+        uint64_t hash = fnv_offset;
+
+        for (int c = 0; c < clause_count; ++c)
+            hash = (hash ^ clause_fingerprint(static_cast<clause>(c))) * fnv_prime;
+        return hash;
+    }
+
+    // the same, hashing again only the clauses that changed since they were
+    // last hashed here or rendered by str(), so after str() it costs no pass
+    uint64_t fingerprint()
+    {
+        uint64_t hash = fnv_offset;
+
+        for (int c = 0; c < clause_count; ++c)
+        {
+            if (_hash_dirty & (1u << c))
+                _clause_hash[c] = clause_fingerprint(static_cast<clause>(c));
+            hash = (hash ^ _clause_hash[c]) * fnv_prime;
+        }
+        _hash_dirty = 0;
+        return hash;
+    }
+
+    SelectModel& reset()
+    {
+        _select_columns.clear();
+        _distinct = false;
+        _groupby_columns.clear();
+        _table_name = column(resource());
+        _join_type.clear();
+        // 64_join_on_condition.clear();
+        _where_condition.clear();
+        _having_condition.clear();
+        _order_by.clear();
+        _order_keys.clear();
+        _seek = column(resource());
+        _limit.clear();
+        _offset.clear();
+        _dirty      = all_clauses;
+        _hash_dirty = all_clauses;
+        return *this;
+    }
+
+    friend inline std::ostream& operator<<(std::ostream& out, const SelectModel& mod)
+    {
+        SqlStreamSink sink(out);
+
+        mod.render_to(sink);
+        return out;
+    }
+
+protected:
+    // parts of the statement cached separately by str()
+    enum clause
+    {
+        select_clause,
+        from_clause,
+        join_clause,
+        where_clause,
+        group_by_clause,
+        having_clause,
+        order_by_clause,
+        tail_clause,  // limit and offset
+        clause_count
+    };
+
+    static const uint32_t all_clauses = (1u << clause_count) - 1;
+
+    void touch(clause c)
+    {
+        _dirty      |= 1u << c;
+        _hash_dirty |= 1u << c;
+    }
+
+    // name of a sort_key: the table part of table.column as written, the
+    // column quoted, as column(name, table) renders it
+    static void append_key(std::pmr::string& out, std::string_view name)
+    {
+        size_t dot = name.rfind('.');
+
+        if (dot != std::string_view::npos)
+        {
+            out.append(name.substr(0, dot + 1));
+            name.remove_prefix(dot + 1);
+        }
+        append_quoted(out, name);
+    }
+
+    // an order_by() other than order_by_keys() ends the keyset pagination
+    void drop_keys()
+    {
+        if (_order_keys.empty() && _seek.root() == expr_node::npos)
+            return;
+        _order_keys.clear();
+        _seek = column(resource());
+        touch(where_clause);
+    }
+
+    virtual uint64_t render_hashed(std::string& out) const override
+    {
+        uint64_t hash = fnv_offset;
+
+        for (int c = 0; c < clause_count; ++c)
+        {
+            uint64_t clause_hash = fnv_offset;
+            SqlWriter w(out, clause_hash);
+
+            render_clause(w, static_cast<clause>(c));
+            hash = (hash ^ clause_hash) * fnv_prime;
+        }
+        return hash;
+    }
+
+    uint64_t clause_fingerprint(clause c) const
+    {
+        uint64_t hash = fnv_offset;
+        SqlWriter w(hash);
+
+        render_clause(w, c);
+        return hash;
+    }
+
+    void render_clause(SqlWriter& w, clause c) const
+    {
+        switch (c)
+        {
+        case select_clause:
+            w.append(" SELECT ");
+
+            if (_distinct)
+                w.append(" DISTINCT ");
+            join_vector(w, _select_columns, ", ");
+            break;
+
+        case from_clause:
+            w.append(" FROM ");
+            _table_name.render(w);
+            break;
+
+        case join_clause:
+
+            for (const auto& join : _join_type)
+            {
+                w.append(" ");
+                w.append(join.first);
+                join.second.render(w);
+                w.append(" ");
+            }
+            break;
+
+        case where_clause:
+
+            if (!_where_condition.empty())
+            {
+                w.append(" WHERE ");
+                join_vector(w, _where_condition, " AND ");
+            }
+
+            if (_seek.root() != expr_node::npos)
+            {
+                w.append(_where_condition.empty() ? " WHERE " : " AND ");
+                _seek.render(w);
+            }
+            break;
+
+        case group_by_clause:
+
+            if (!_groupby_columns.empty())
+            {
+                w.append(" group by ");
+                join_vector(w, _groupby_columns, ", ");
+            }
+            break;
+
+        case having_clause:
+
+            if (!_having_condition.empty())
+            {
+                w.append(" having ");
+                join_vector(w, _having_condition, " and ");
+            }
+            break;
+
+        case order_by_clause:
+
+            if (!_order_by.empty())
+            {
+                w.append(" ORDER BY ");
+                w.append(_order_by);
 
-        _sql_func.append(")");
-        _sql_func.append(" OVER ");
-        _sql_func.append("(");
+                if (_order_by_desc)
+                    w.append(" DESC ");
+            }
+            break;
 
+        case tail_clause:
 
-        if (partition.length() > 2)
-        {
-            _sql_func.append("PARTITION BY ");
-            _sql_func.append(partition);
+            if (!_limit.empty())
+            {
+                w.append(" limit ");
+                w.literal(_limit, literal_type::integer);
+            }
 
-            _sql_func.append(" ");
-        }
+            if (!_offset.empty())
+            {
+                w.append(" offset ");
+                w.literal(_offset, literal_type::integer);
+            }
+            break;
 
-        if  (order_by.length() > 2)
-        {
-            _sql_func.append("ORDER BY ");
-            _sql_func.append(order_by);
-            _sql_func.append(" ");
-            desc ? _sql_func.append(" DESC ")
-                 : _sql_func.append(" ASC ");
-            _sql_func.append(" ) ");
+        default:
+            break;
         }
+    }
 
-        if  (!as.empty())
-            _sql_func.append(" AS " + as);
-
-        return *this;
+    std::pmr::memory_resource* resource() const
+    {
+        return _select_columns.get_allocator().resource();
     }
 
-    SqlWindowFunction& w_function(const std::string&  function_name,
-                                  const std::string& column
-                                  ,
-                                  const std::string& partition = ""
-                                  ,
-                                  const std::vector<std::pair<std::string, bool>> order_by_desc = std::vector<std::pair<std::string, bool>>
-                                                                                                  ()
-                                  ,
-                                  const std::string& as = "")
+    template<typename ... Columns>
+    void select_projection(column_list<Columns ...>)
     {
-        _sql_func.clear();
-        _sql_func.append(function_name);
+        (_select_columns.push_back(column::of<Columns>(resource())), ...);
+    }
 
-        _sql_func.append("(");
+    // copy of a subquery shared by the copies of this model
+    std::shared_ptr<const SqlModel> shared(const SelectModel& model) const
+    {
+        return freeze(model, resource());
+    }
 
-        if (!column.empty() || (column.length() > 2))
-            _sql_func.append(column);
+    std::shared_ptr<const SqlModel> shared(SelectModel&& model) const
+    {
+        return freeze(std::move(model), resource());
+    }
 
-        _sql_func.append(")");
-        _sql_func.append(" OVER ");
-        _sql_func.append("(");
+    virtual void detach() override
+    {
+        for (column& c : _select_columns)
+            c.detach();
+        _table_name.detach();
 
+        for (auto& join : _join_type)
+            join.second.detach();
 
-        if (partition.length() > 2)
-        {
-            _sql_func.append("PARTITION BY ");
-            _sql_func.append(partition);
+        for (column& c : _where_condition)
+            c.detach();
 
-            _sql_func.append(" ");
-        }
+        for (column& c : _having_condition)
+            c.detach();
+        _seek.detach();
+    }
 
-        if (order_by_desc.size() > 0)
-        {
-            _sql_func.append("ORDER BY ");
+    std::pmr::vector<column> _select_columns;
+    bool _distinct;
+    std::pmr::vector<std::pmr::string> _groupby_columns;
+    // from clause, table names and subqueries
+    column _table_name;
+    std::pmr::vector<std::pair<std::pmr::string, column>> _join_type;
 
-            for (int i  = 0; i  < order_by_desc.size(); i++)
-            {
-                if  (order_by_desc.at(i).first.length() > 2)
-                {
-                    _sql_func.append(order_by_desc.at(i).first);
-                    _sql_func.append(" ");
-                    order_by_desc.at(i).second ? _sql_func.append(" DESC , ")
-                                               : _sql_func.append(" ASC , ");
-                }
-            }
-            _sql_func = _sql_func.substr(0, _sql_func.size() - 3);
+    // std::vector<std::string> _join_on_condition;
+    std::pmr::vector<column> _where_condition;
+    std::pmr::vector<column> _having_condition;
+    std::pmr::string _order_by;
+    bool _order_by_desc = false;
+    // quoted names and directions of the keys of order_by_keys(), and the
+    // keyset predicate of seek_after()
+    std::pmr::vector<std::pair<std::pmr::string, bool>> _order_keys;
+    column _seek;
+    std::pmr::string _limit;
+    std::pmr::string _offset;
+    // rendered text of each clause for str(), and the clauses changed since
+    std::pmr::vector<std::pmr::string> _clause_text;
+    uint32_t _dirty = all_clauses;
+    // fingerprint of each clause, and the clauses changed since
+    uint64_t _clause_hash[clause_count] = {};
+    uint32_t _hash_dirty = all_clauses;
+};
 
-            _sql_func.append(" ) ");
-        }
+inline std::string to_value(SelectModel& data)
+{
+    return data.str();
+}
 
-        if  (!as.empty())
-            _sql_func.append(" AS " + as);
+class InsertModel : public SqlModel
+{
+public:
+    InsertModel(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _table_name(resource),
+        _columns(resource),
+        _values(resource),
+        _value_nodes(resource),
+        _conflict_target(resource),
+        _conflict_set(resource),
+        _conflict_where(resource) {}
+    InsertModel(const InsertModel& data) = default;
+    InsertModel(InsertModel&& data)      = default;
+    virtual ~InsertModel() {}
 
+    template<typename T>
+    InsertModel& insert(const std::string& c, const T& data)
+    {
+        check_single_row();
+        append_quoted(_columns.emplace_back(), c);
+        _values.push_back(row_value(data));
         return *this;
     }
-};
-
-class TimeFormatingFunction : public SqlFunction
-{
-public:
-    TimeFormatingFunction() {}
-    virtual ~TimeFormatingFunction() {}
 
+    InsertModel& insert(const std::string& c)
+    {
+        check_single_row();
+        append_quoted(_columns.emplace_back(), c);
+        _values.push_back(_value_nodes.add(expr_kind::param, " ? "));
+        return *this;
+    }
 
-    TimeFormatingFunction& to_timestamp(const column& data)
+    template<typename T>
+    InsertModel& insert(const ident& c, const T& data)
     {
-        return t_function("to_timestamp", data);
+        check_single_row();
+        append_quoted(_columns.emplace_back(), c);
+        _values.push_back(row_value(data));
+        return *this;
     }
 
-    virtual   std::string  str() const override
+    InsertModel& insert(const ident& c)
     {
-        return _sql_func;
+        check_single_row();
+        append_quoted(_columns.emplace_back(), c);
+        _values.push_back(_value_nodes.add(expr_kind::param, " ? "));
+        return *this;
     }
 
-private:
-    TimeFormatingFunction& t_function(const std::string& name, const column& data)
+    // column declared with SQL_COLUMN, data must convert to its value type
+    template<typename Column, typename T>
+    InsertModel& insert(const T& data)
     {
-        _sql_func.append(name + "(" + data.str() + ")");
+        static_assert(std::is_convertible<const T&, typename Column::value_type>::value, "value of the column's type");
+        check_single_row();
+        _columns.emplace_back(Column::sql_quoted);
+        _values.push_back(row_value(data));
         return *this;
     }
-};
 
-class CastFunction : public SqlFunction
-{
-public:
-    CastFunction(const column expression,
+    template<typename T>
+    InsertModel& operator()(const std::string& c, const T& data)
+    {
+        return insert(c, data);
+    }
 
-                 const  std::string& data_type = "",
-                 const int& length = 30)
+    InsertModel& operator()(const std::string& c)
     {
-        _sql_func = "CAST(";
-        _sql_func.append(expression.str() +  " AS " + data_type + ") ");
+        return insert(c);
     }
 
-    std::string str() const override
+    // column list of a multi-row insert, followed by values() per row
+    template<typename ... Args>
+    InsertModel& columns(const Args& ... names)
     {
-        return _sql_func;
+        if (!_values.empty())
+            throw std::logic_error("sql: columns() after values()");
+        (append_quoted(_columns.emplace_back(), names), ...);
+        _multi_row = true;
+        return *this;
     }
-};
 
+    // appends a row, one value per column
+    template<typename ... Args>
+    InsertModel& values(const Args& ... row)
+    {
+        static_assert(sizeof...(Args) > 0, "a row of at least one value");
 
+        if (sizeof...(Args) != _columns.size())
+            throw std::invalid_argument("sql: values() needs one value per column");
+        (_values.push_back(row_value(row)), ...);
+        _multi_row = true;
+        return *this;
+    }
 
+    size_t rows() const
+    {
+        return _columns.empty() ? 0 : _values.size() / _columns.size();
+    }
 
-class RoundFunction : public SqlFunction
-{
-public:
-    RoundFunction(const CastFunction expression,
-                  const std::string& as = "",
-                  const int& length = 30)
+    // renders the rows as consecutive statements within limits and calls
+    // f(const std::string&) for each, returns the number of statements
+    template<typename F>
+    size_t for_each_chunk(const chunk_limits& limits, F&& f) const
     {
-        _sql_func = "ROUND(";
-        _sql_func.append(expression.str() +  " , " + std::to_string(length) + ") ");
+        size_t rows   = this->rows();
+        size_t chunks = 0;
+        SqlWriter counter;
 
-        if (!as.empty())
-            _sql_func.append(" AS " + as);
+        render_head(counter);
+        render_conflict(counter);
+        size_t head = counter.size();
+        std::string sql;
+
+        for (size_t first = 0; first < rows; ++chunks)
+        {
+            size_t last = rows_end(limits, head, first);
+
+            sql.clear();
+            SqlWriter w(sql);
+            render_head(w);
+            render_rows(w, first, last);
+            render_conflict(w);
+            f(sql);
+            first = last;
+        }
+        return chunks;
     }
 
-    RoundFunction(const column expression,
-                  const std::string& as = "",
-                  const int& length = 30)
+    const std::pmr::string& table_name() const
     {
-        _sql_func = "ROUND(";
-        _sql_func.append(expression.str() +  " , " + std::to_string(length) + ") ");
-
-        if (!as.empty())
-            _sql_func.append(" AS " + as);
+        return _table_name;
     }
 
-    std::string str() const override
+    const std::pmr::vector<std::pmr::string>& column_names() const
     {
-        return _sql_func;
+        return _columns;
     }
-};
 
+    std::vector<std::string> chunks(const chunk_limits& limits) const
+    {
+        std::vector<std::string> statements;
 
+        for_each_chunk(limits, [&statements](const std::string& sql) {
+            statements.push_back(sql);
+        });
+        return statements;
+    }
 
-class DataTypeFormatingFunction : public SqlFunction
-{
-public:
-    DataTypeFormatingFunction(const std::string& as = "")
+    InsertModel& into(const std::string& table_name, const std::string& tablespace = "")
     {
-        if (!as.empty())
-            _as.append(" AS " + quotes + as + quotes);
+        _table_name.clear();
+
+        if (!tablespace.empty())
+            _table_name.append(tablespace).append(".");
+        append_quoted(_table_name, table_name);
+        return *this;
     }
 
-    std::string str() const override
+    InsertModel& into(const ident& table_name)
     {
-        return _sql_func + _as;
+        _table_name.clear();
+        append_quoted(_table_name, table_name);
+        return *this;
     }
 
-    virtual ~DataTypeFormatingFunction() {}
+    template<typename Table>
+    InsertModel& into()
+    {
+        _table_name = Table::sql_quoted;
+        return *this;
+    }
 
+    InsertModel& replace(bool var)
+    {
+        _replace = var;
+        return *this;
+    }
 
-    DataTypeFormatingFunction& to_char(const sql::TimeFormatingFunction& tf_func,
-                                       const bool& is_text,
-                                       const  std::string& format = "")
+    // upsert of postgres and sqlite: rows that conflict on the given unique
+    // columns are updated by do_update(), skipped otherwise. Without columns
+    // std::logic_error is thrown.
+    template<typename ... Args>
+    InsertModel& on_conflict(const Args& ... names)
     {
-        DataTypeFormatingFunction& text = dtf_function("to_char", tf_func.str(), is_text, format);
+        size_t i = 0;
 
+        if (sizeof...(Args) == 0)
+            throw std::logic_error("sql: on_conflict() without columns");
 
-        return text;
+        _conflict_target.assign(" on conflict (");
+        ((i++ ? _conflict_target.append(", ") : _conflict_target, append_quoted(_conflict_target, names)), ...);
+        _conflict_target.append(")");
+        return *this;
     }
 
-    DataTypeFormatingFunction& to_char(const column& data,
-                                       const std::string& format = "")
+    InsertModel& on_conflict_constraint(const std::string& name)
     {
-        return dtf_function("to_char", data.str(), true, format);
+        _conflict_target.assign(" on conflict on constraint ");
+        append_quoted(_conflict_target, name);
+        return *this;
     }
 
-    DataTypeFormatingFunction& to_char(const column_value& data,
-                                       const std::string& format = "")
+    InsertModel& do_nothing()
     {
-        return dtf_function("to_char", data.str(), false, format);
+        _conflict = conflict_action::nothing;
+        _conflict_set.clear();
+        return *this;
     }
 
-private:
-    DataTypeFormatingFunction& dtf_function(const std::string& name,
-                                            const std::string& data,
-                                            const bool& is_column,
-                                            const  std::string& format = "")
+    // sets each column to its value in the conflicting row: col = excluded.col,
+    // throws std::logic_error without columns
+    template<typename ... Args>
+    InsertModel& do_update(const Args& ... names)
     {
-        _sql_func.append(name);
+        if (sizeof...(Args) == 0)
+            throw std::logic_error("sql: do_update() without columns");
+        _conflict = conflict_action::update;
+        (append_quoted(_conflict_set.emplace_back(), names), ...);
+        return *this;
+    }
 
-        _sql_func.append("(");
-        _sql_func.append(data);
+    // rows of the table that do_update() changes, others are left as they are
+    InsertModel& do_update_where(column condition)
+    {
+        _conflict_where = std::move(condition);
+        return *this;
+    }
 
-        if (!format.empty())
-            _sql_func.append(", '" + format + "'");
-        _sql_func.append(")");
+    InsertModel& do_update_where(const std::string& condition)
+    {
+        _conflict_where = column::raw(condition, _conflict_set.get_allocator().resource());
         return *this;
     }
 
-    std::string _as;
-};
+    virtual void render(SqlWriter& w) const override
+    {
+        render_head(w);
+        render_rows(w, 0, rows());
+        render_conflict(w);
+    }
 
+    InsertModel& reset()
+    {
+        _table_name.clear();
+        _columns.clear();
+        _values.clear();
+        _value_nodes.clear();
+        _multi_row = false;
+        _conflict_target.clear();
+        _conflict = conflict_action::none;
+        _conflict_set.clear();
+        _conflict_where = column(_conflict_set.get_allocator().resource());
+        return *this;
+    }
 
+    friend inline std::ostream& operator<<(std::ostream& out, const InsertModel& mod)
+    {
+        SqlStreamSink sink(out);
 
+        mod.render_to(sink);
+        return out;
+    }
 
-class conditional_expressions : public SqlFunction
-{
-public:
-    conditional_expressions(const std::string& as = "")
+protected:
+    virtual void detach() override
     {
-        _sql_func.append(" COALESCE ( ");
+        _conflict_where.detach();
+    }
 
-        if (!as.empty())
-            _as.append(" AS " +   as);
+    template<typename T>
+    uint32_t row_value(const T& data)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+            return _value_nodes.add(literal_type::boolean, data ? "TRUE" : "FALSE");
+        else
+            return _value_nodes.add_value(data);
     }
 
-    virtual  std::string str() const override
+    void render_head(SqlWriter& w) const
+    {
+        if (_replace)
+            w.append("insert or replace into ");
+        else
+            w.append("insert into ");
+
+        w.append(_table_name);
+        w.append("(");
+
+        if (!_columns.empty())
+        {
+            join_vector(w, _columns, ", ");
+            w.append(")");
+        }
+    }
+
+    // a target alone skips conflicting rows, do_nothing() alone skips rows
+    // conflicting on any constraint; do_update() needs to know which
+    void render_conflict(SqlWriter& w) const
     {
-        return _sql_func + _as;
+        if (_conflict_target.empty())
+        {
+            if (_conflict == conflict_action::none)
+                return;
+
+            if (_conflict == conflict_action::update)
+                throw std::logic_error("sql: do_update() without an on_conflict() target");
+            w.append(" on conflict");
+        }
+        else
+        {
+            w.append(_conflict_target);
+        }
+
+        if (_conflict != conflict_action::update)
+        {
+            w.append(" do nothing");
+            return;
+        }
+        w.append(" do update set ");
+
+        for (size_t i = 0; i < _conflict_set.size(); ++i)
+        {
+            if (i > 0)
+                w.append(", ");
+            w.append(_conflict_set[i]);
+            w.append(" = excluded.");
+            w.append(_conflict_set[i]);
+        }
+
+        if (_conflict_where.root() != expr_node::npos)
+        {
+            w.append(" where ");
+            _conflict_where.render(w);
+        }
     }
 
-    virtual  ~conditional_expressions() {}
+    void render_row(SqlWriter& w, size_t row) const
+    {
+        size_t width = _columns.size();
 
-    template<typename T, typename ... Args>
-    conditional_expressions& coalesce(const T& col, Args&& ... cols)
+        for (size_t i = 0; i < width; ++i)
+        {
+            if (i > 0)
+                w.append(", ");
+            _value_nodes.render(w, _values[row * width + i]);
+        }
+    }
+
+    void render_rows(SqlWriter& w, size_t first, size_t last) const
     {
-        _sql_func.append(to_value(col) + " , ");
-        coalesce(cols ...);
-        return *this;
+        w.append(" values(");
+
+        for (size_t row = first; row < last; ++row)
+        {
+            if (row > first)
+                w.append(", (");
+            render_row(w, row);
+            w.append(")");
+        }
     }
 
-private:
-    conditional_expressions& coalesce()
+    // end of the statement that starts at row first, head is the size of
+    // the statement without rows
+    size_t rows_end(const chunk_limits& limits, size_t head, size_t first) const
     {
-        // remove last comma
-        if (_sql_func.size() > 4)
-            _sql_func = _sql_func.substr(0, _sql_func.size() - 3);
-        _sql_func.append(" ) ");
-        return *this;
-    }
+        SqlWriter counter;
+        size_t rows = this->rows();
+        size_t last = first + 1;
 
-    std::string _as = "";
-};
+        render_row(counter, first);
+        // head values(row)
+        size_t bytes = head + 9 + counter.size();
 
-class SqlModel
-{
-public:
-    SqlModel() {}
-    virtual ~SqlModel() {}
+        for (; last < rows; ++last)
+        {
+            size_t count = last - first + 1;
+            SqlWriter row;
 
-    virtual const std::string& str() = 0;
-    const std::string& last_sql()
+            render_row(row, last);
+            // , (row)
+            bytes += 4 + row.size();
+
+            if ((limits.max_rows && count > limits.max_rows) ||
+                (limits.max_params && count * _columns.size() > limits.max_params) ||
+                (limits.max_bytes && bytes > limits.max_bytes))
+                break;
+        }
+        return last;
+    }
+
+    // insert() adds a column and its value to a single row, which would shift
+    // every row after the first of columns() and values()
+    void check_single_row() const
     {
-        return _sql;
+        if (_multi_row)
+            throw std::logic_error("sql: insert() after columns() or values()");
     }
 
-private:
-    //  SqlModel(const SqlModel& m)               = delete;
-    SqlModel& operator=(const SqlModel& data) = delete;
+    bool _replace = false;
+    std::pmr::string _table_name;
+    std::pmr::vector<std::pmr::string> _columns;
+    // one node of _value_nodes per column and row
+    std::pmr::vector<uint32_t> _values;
+    expression _value_nodes;
+    // rows are given by columns() and values() rather than insert()
+    bool _multi_row = false;
+
+    enum class conflict_action : uint8_t
+    {
+        none,
+        nothing,
+        update
+    };
+
+    // " on conflict (...)", the action and the columns it sets
+    std::pmr::string _conflict_target;
+    conflict_action _conflict = conflict_action::none;
+    std::pmr::vector<std::pmr::string> _conflict_set;
+    column _conflict_where;
+};
 
-protected:
-    std::string _sql;
+enum class copy_format
+{
+    text,
+    binary
 };
 
-class SelectModel : public SqlModel
+// COPY ... FROM STDIN for the table and columns of an InsertModel, plus the
+// rows encoded in the text or binary copy format of postgres. Binary fields
+// are sized by their C++ type: int2, int4 or int8 wide enough for every value
+// of the integer type, float4 and float8. uint64_t fits none of them.
+class CopyModel : public SqlModel
 {
 public:
-    SelectModel() :
-        _distinct(false) {}
-    virtual ~SelectModel() {}
+    CopyModel(const InsertModel& insert, copy_format format = copy_format::text) :
+        _table_name(insert.table_name()),
+        _columns(insert.column_names().begin(), insert.column_names().end()),
+        _format(format)
+    {
+        if (_format == copy_format::binary)
+        {
+            _data.append("PGCOPY\n\377\r\n\0", 11);
+            put_int<uint32_t>(0);  // flags
+            put_int<uint32_t>(0);  // header extension length
+        }
+    }
+    virtual ~CopyModel() {}
 
+    // encodes a row, one value per column
     template<typename ... Args>
-    SelectModel& select(const std::string& str, Args&& ... columns)
+    CopyModel& row(const Args& ... values)
     {
-        const std::string& pb(quotes + str + quotes);
+        static_assert(sizeof...(Args) > 0, "a row of at least one value");
 
-        _select_columns.push_back(pb);
-        select(columns ...);
+        if (sizeof...(Args) != _columns.size())
+            throw std::invalid_argument("sql: row() needs one value per column");
+
+        if (_format == copy_format::text)
+        {
+            size_t field = 0;
+
+            ((field++ > 0 ? _data.push_back('\t') : void(), text_field(values)), ...);
+            _data.push_back('\n');
+        }
+        else
+        {
+            put_int<uint16_t>(sizeof...(Args));
+            (binary_field(values), ...);
+        }
+        ++_rows;
         return *this;
     }
 
-    template<typename ... Args>
-    SelectModel& select(const SqlFunction& sql_function, Args&& ... columns)
+    // terminates a binary stream, no further rows may follow
+    CopyModel& end()
     {
-        const std::string& pb = sql_function.str();
-
-        _select_columns.push_back(pb);
-        select(columns ...);
+        if (_format == copy_format::binary)
+            put_int<uint16_t>(0xffff);
         return *this;
     }
 
-    template<typename ... Args>
-    SelectModel& select(std::pair<SelectModel, std::string> subquery, Args&& ... columns)
+    // encoded rows, passed to the server after the statement
+    const std::string& data() const
     {
-        std::string pb(" ( ");
+        return _data;
+    }
 
-        pb.append(subquery.first.str());
-        pb.append(" ) ");
+    size_t rows() const
+    {
+        return _rows;
+    }
 
-        if (!subquery.second.empty())
-        {
-            pb.append(" AS ");
-            pb.append(subquery.second);
-        }
+    virtual void render(SqlWriter& w) const override
+    {
+        w.append("COPY ");
+        w.append(_table_name);
+        w.append("(");
+        join_vector(w, _columns, ", ");
+        w.append(") FROM STDIN");
 
-        _select_columns.push_back(pb);
-        select(columns ...);
-        return *this;
+        if (_format == copy_format::binary)
+            w.append(" WITH (FORMAT binary)");
     }
 
-    template<typename ... Args>
-    SelectModel& select(const column column_struct, Args&& ... columns)
+private:
+    template<typename T>
+    void put_int(T value)
     {
-        const std::string& pb = column_struct.str();
+        for (size_t i = sizeof(T); i > 0; --i)
+            _data.push_back(static_cast<char>((value >> ((i - 1) * 8)) & 0xff));
+    }
 
-        _select_columns.push_back(pb);
-        select(columns ...);
-        return *this;
+    void text_field(std::nullptr_t)
+    {
+        _data.append("\\N");
     }
 
-    template<typename ... Args>
-    SelectModel& select(const column_value data, Args&& ... columns)
+    void text_field(std::string_view data)
     {
-        const std::string& pb = data.str();
+        for (char c : data)
+        {
+            switch (c)
+            {
+            case '\\': _data.append("\\\\"); break;
+            case '\n': _data.append("\\n"); break;
+            case '\r': _data.append("\\r"); break;
+            case '\t': _data.append("\\t"); break;
+            default: _data.push_back(c); break;
+            }
+        }
+    }
 
-        _select_columns.push_back(pb);
-        select(columns ...);
-        return *this;
+    template<typename T>
+    void text_field(const T& data)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+            _data.push_back(data ? 't' : 'f');
+        else if constexpr (std::is_arithmetic<T>::value)
+            append_value(_data, data);
+        else
+            text_field(std::string_view(data));
     }
 
-    // for recursion
-    SelectModel& select()
+    void binary_field(std::nullptr_t)
     {
-        return *this;
+        put_int<uint32_t>(0xffffffff);
     }
 
-    SelectModel& distinct()
+    void binary_field(std::string_view data)
     {
-        _distinct = true;
-        return *this;
+        put_int<uint32_t>(static_cast<uint32_t>(data.size()));
+        _data.append(data);
     }
 
-    // template<typename ... Args>
-    SelectModel& from(const std::string& table_name, const std::string& tablespace = "", const std::string& alias = "")
+    template<typename T>
+    void binary_field(const T& data)
     {
-        if (!tablespace.empty())
+        if constexpr (std::is_same<T, bool>::value)
         {
-            _table_name.append(tablespace);
-            _table_name.append(".");
+            put_int<uint32_t>(1);
+            _data.push_back(data ? 1 : 0);
         }
-        _table_name.append(quotes + table_name + quotes);
+        else if constexpr (std::is_integral<T>::value)
+        {
+            // unsigned values need the next wider signed type
+            constexpr size_t size = std::is_signed<T>::value ? sizeof(T) : 2 * sizeof(T);
 
-        if (!alias.empty())
-            _table_name.append(" " + alias + " ");
+            static_assert(size <= 8, "no binary integer holds every uint64_t, copy it as text");
+
+            if constexpr (size <= 2)
+            {
+                put_int<uint32_t>(2);
+                put_int(static_cast<uint16_t>(data));
+            }
+            else if constexpr (size <= 4)
+            {
+                put_int<uint32_t>(4);
+                put_int(static_cast<uint32_t>(data));
+            }
+            else
+            {
+                put_int<uint32_t>(8);
+                put_int(static_cast<uint64_t>(data));
+            }
+        }
+        else if constexpr (std::is_same<T, float>::value)
+        {
+            uint32_t bits;
+
+            std::memcpy(&bits, &data, sizeof(bits));
+            put_int<uint32_t>(4);
+            put_int(bits);
+        }
+        else if constexpr (std::is_floating_point<T>::value)
+        {
+            double value = data;
+            uint64_t bits;
+
+            std::memcpy(&bits, &value, sizeof(bits));
+            put_int<uint32_t>(8);
+            put_int(bits);
+        }
         else
-            _table_name.append(" ");
+        {
+            binary_field(std::string_view(data));
+        }
+    }
+
+    std::pmr::string _table_name;
+    std::pmr::vector<std::pmr::string> _columns;
+    copy_format _format;
+    std::string _data;
+    size_t _rows = 0;
+};
 
+class UpdateModel : public SqlModel
+{
+public:
+    UpdateModel(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _set_columns(resource),
+        _set_values(resource),
+        _value_nodes(resource),
+        _table_name(resource),
+        _where_condition(resource) {}
+    UpdateModel(const UpdateModel& data) = default;
+    UpdateModel(UpdateModel&& data)      = default;
+    virtual ~UpdateModel() {}
 
+    UpdateModel& update(const std::string& table_name)
+    {
+        _table_name = table_name;
         return *this;
     }
 
-    SelectModel& from_subquery(const std::string& table_name, const std::string& alias = "")
+    template<typename T>
+    UpdateModel& set(const std::string& c, const T& data)
     {
-        _table_name.append(table_name);
-
-        if (!alias.empty())
-            _table_name.append(" " + alias + " ");
-        else
-            _table_name.append(" ");
+        _set_columns.emplace_back(c).append(" = ");
+        _set_values.push_back(_value_nodes.add_value(data));
+        return *this;
+    }
 
+    template<typename T>
+    UpdateModel& operator()(const std::string& c, const T& data)
+    {
+        return set(c, data);
+    }
 
+    UpdateModel& where(const std::string& condition)
+    {
+        _where_condition.push_back(column::raw(condition, _where_condition.get_allocator().resource()));
         return *this;
     }
 
-    SelectModel& from(std::vector<SelectModel> selects,  const std::string& alias = "")
+    UpdateModel& where(column condition)
     {
-        for (int i = 0; i < selects.size(); i++)
-        {
-            std::string subs_q = selects[i].str();
+        _where_condition.push_back(std::move(condition));
+        return *this;
+    }
 
-            _table_name.append(" ( " + subs_q + " )");
+    virtual void render(SqlWriter& w) const override
+    {
+        w.append("update ");
+        w.append(_table_name);
+        w.append(" set ");
 
-            if (i != selects.size())
-                _table_name.append(" UNION ALL ");
+        for (size_t i = 0; i < _set_columns.size(); ++i)
+        {
+            if (i > 0)
+                w.append(", ");
+            w.append(_set_columns[i]);
+            _value_nodes.render(w, _set_values[i]);
         }
 
-        if (!alias.empty())
-            _table_name.append(" " + alias + " ");
-        else
-            _table_name.append(" ");
+        if (!_where_condition.empty())
+        {
+            w.append(" WHERE ");
+            join_vector(w, _where_condition, " and ");
+        }
+    }
 
+    UpdateModel& reset()
+    {
+        _table_name.clear();
+        _set_columns.clear();
+        _set_values.clear();
+        _value_nodes.clear();
+        _where_condition.clear();
         return *this;
     }
 
-    SelectModel& join_statement(const std::string& join_type,
-                                const std::string& table_name,
-                                const std::string& tablespace,
-                                const std::string& alias,
-                                const std::string& on_conditions)
+    friend inline std::ostream& operator<<(std::ostream& out, const UpdateModel& mod)
     {
-        //        std::vector<std::pair<std::string, std::vector<std::string>>> type;
-
-        std::string join_type_and_table(" " + join_type + " ");
-
-        if (!tablespace.empty())
-            join_type_and_table.append(tablespace + ".");
+        SqlStreamSink sink(out);
 
-        join_type_and_table.append(quotes + table_name + quotes);
+        mod.render_to(sink);
+        return out;
+    }
 
-        if (!alias.empty())
-            join_type_and_table.append(" " + alias + " ");
+protected:
+    virtual void detach() override
+    {
+        for (column& c : _where_condition)
+            c.detach();
+    }
 
-        join_type_and_table.append("ON " + on_conditions);
+    // "column = " and the node of its value in _value_nodes
+    std::pmr::vector<std::pmr::string> _set_columns;
+    std::pmr::vector<uint32_t> _set_values;
+    expression _value_nodes;
+    std::pmr::string _table_name;
+    std::pmr::vector<column> _where_condition;
+};
 
-        _join_type.push_back(join_type_and_table);
+// UPDATE of many rows, each with values of its own, in one statement that
+// joins the table to a VALUES list on key columns:
+//
+//   update "user" set "name" = v."name" from (values (1::int4, 'a'::text),
+//   (2, 'b')) as v("id", "name") where "user"."id" = v."id"
+//
+// The values of the first row of a statement are cast, which postgres
+// applies to the whole VALUES column, so placeholders in later rows need no
+// casts. A column is cast to the type given by cast(), else after the C++
+// type of its first value that is not null.
+class BulkUpdateModel : public SqlModel
+{
+public:
+    BulkUpdateModel(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _table_name(resource),
+        _columns(resource),
+        _casts(resource),
+        _values(resource),
+        _value_nodes(resource) {}
+    BulkUpdateModel(const BulkUpdateModel& data) = default;
+    BulkUpdateModel(BulkUpdateModel&& data)      = default;
+    virtual ~BulkUpdateModel() {}
+
+    BulkUpdateModel& update(const std::string& table_name, const std::string& tablespace = "")
+    {
+        _table_name.clear();
 
+        if (!tablespace.empty())
+            _table_name.append(tablespace).append(".");
+        append_quoted(_table_name, table_name);
         return *this;
     }
 
-    SelectModel& left_join(const std::string& table_name,
-                           const column& on_conditions,
-                           const std::string& tablespace = "",
-                           const std::string& alias      = ""
-                           )
+    // columns a row is matched on
+    template<typename ... Args>
+    BulkUpdateModel& keys(const Args& ... names)
     {
-        join_statement("LEFT JOIN", table_name, tablespace, alias, on_conditions.str());
-
+        if (!_values.empty())
+            throw std::logic_error("sql: keys() after values()");
+        ((append_quoted(*_columns.emplace(_columns.begin() + _keys), names),
+          _casts.emplace(_casts.begin() + _keys),
+          ++_keys), ...);
         return *this;
     }
 
-    SelectModel& left_outer_join(const std::string& table_name,
-                                 const column& on_conditions,
-                                 const std::string& tablespace = "",
-                                 const std::string& alias      = "")
+    // columns set from a row
+    template<typename ... Args>
+    BulkUpdateModel& columns(const Args& ... names)
     {
-        join_statement("left outer join", table_name, tablespace, alias, on_conditions.str());
-
+        if (!_values.empty())
+            throw std::logic_error("sql: columns() after values()");
+        ((append_quoted(_columns.emplace_back(), names), _casts.emplace_back()), ...);
         return *this;
     }
 
-    SelectModel& right_join(const std::string& table_name,
-                            const column& on_conditions,
-                            const std::string& tablespace = "",
-                            const std::string& alias      = ""
-                            )
+    // sql type of a key or column, such as uuid, timestamptz or jsonb, in
+    // place of the one its values give
+    BulkUpdateModel& cast(const std::string& name, const std::string& type)
     {
-        join_statement(" right join ", table_name, tablespace, alias, on_conditions.str());
+        std::pmr::string quoted(_columns.get_allocator().resource());
+
+        append_quoted(quoted, name);
+        auto found = std::find(_columns.begin(), _columns.end(), quoted);
+
+        if (found == _columns.end())
+            throw std::invalid_argument("sql: cast() of a name not in keys() or columns()");
+        _casts[found - _columns.begin()].assign("::").append(type);
         return *this;
     }
 
-    SelectModel& right_outer_join(const std::string& table_name,
-                                  const column& on_conditions,
-                                  const std::string& tablespace = "",
-                                  const std::string& alias      = "")
+    // appends a row: the values of the keys, then those of the columns
+    template<typename ... Args>
+    BulkUpdateModel& values(const Args& ... row)
     {
-        join_statement(" RIGHT OUTER JOIN ", table_name, tablespace, alias, on_conditions.str());
+        static_assert(sizeof...(Args) > 0, "a row of at least one value");
+
+        if (sizeof...(Args) != _columns.size())
+            throw std::invalid_argument("sql: values() needs one value per key and column");
+
+        size_t i = 0;
+
+        ((_casts[i].empty() ? void(_casts[i].assign(value_cast<Args>())) : void(), ++i), ...);
+        (_values.push_back(row_value(row)), ...);
         return *this;
     }
 
-    SelectModel& full_join(const std::string& table_name,
-                           const column& on_conditions,
-                           const std::string& tablespace = "",
-                           const std::string& alias      = "")
+    size_t rows() const
     {
-        join_statement(" full join ", table_name, tablespace, alias, on_conditions.str());
-        return *this;
+        return _columns.empty() ? 0 : _values.size() / _columns.size();
     }
 
-    SelectModel& full_outer_join(const std::string& table_name,
-                                 const column& on_conditions,
-                                 const std::string& tablespace = "",
-                                 const std::string& alias      = "")
+    // renders the rows as consecutive statements within limits and calls
+    // f(const std::string&) for each, returns the number of statements
+    template<typename F>
+    size_t for_each_chunk(const chunk_limits& limits, F&& f) const
     {
-        join_statement(" FULL OUTER JOIN ", table_name, tablespace, alias, on_conditions.str());
-        return *this;
+        size_t rows   = this->rows();
+        size_t chunks = 0;
+        SqlWriter counter;
+
+        render_head(counter);
+        render_tail(counter);
+        size_t fixed = counter.size();
+        std::string sql;
+
+        for (size_t first = 0; first < rows; ++chunks)
+        {
+            size_t last = rows_end(limits, fixed, first);
+
+            sql.clear();
+            SqlWriter w(sql);
+            render_head(w);
+            render_rows(w, first, last);
+            render_tail(w);
+            f(sql);
+            first = last;
+        }
+        return chunks;
     }
 
-    SelectModel& where(const std::string& condition)
+    std::vector<std::string> chunks(const chunk_limits& limits) const
     {
-        _where_condition.push_back(condition);
-        return *this;
+        std::vector<std::string> statements;
+
+        for_each_chunk(limits, [&statements](const std::string& sql) {
+            statements.push_back(sql);
+        });
+        return statements;
     }
 
-    SelectModel& where(const column& condition)
+    virtual void render(SqlWriter& w) const override
     {
-        _where_condition.push_back(condition.str());
-        return *this;
+        render_head(w);
+        render_rows(w, 0, rows());
+        render_tail(w);
     }
 
-    SelectModel& where(const  column_value& condition)
+    BulkUpdateModel& reset()
     {
-        _where_condition.push_back(condition.str());
+        _table_name.clear();
+        _columns.clear();
+        _keys = 0;
+        _casts.clear();
+        _values.clear();
+        _value_nodes.clear();
         return *this;
     }
 
-    SelectModel& where_exists(std::vector<SelectModel> data)
+    friend inline std::ostream& operator<<(std::ostream& out, const BulkUpdateModel& mod)
     {
-        std::string where_c;
+        SqlStreamSink sink(out);
 
-        for (int i = 0; i < data.size(); i++)
-        {
-            where_c.append("(EXISTS (");
-            where_c.append(data[i].str());
-            where_c.append(" ) ) OR ");
-        }
-        where_c = where_c.substr(0, where_c.length() - 3);
+        mod.render_to(sink);
+        return out;
+    }
 
-        _where_condition.push_back(where_c);
-        return *this;
+protected:
+    template<typename T>
+    uint32_t row_value(const T& data)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+            return _value_nodes.add(literal_type::boolean, data ? "TRUE" : "FALSE");
+        else
+            return _value_nodes.add_value(data);
     }
 
-    SelectModel& where_not_exists(std::vector<SelectModel> data)
+    void render_head(SqlWriter& w) const
     {
-        std::string where_c;
+        w.append("update ");
+        w.append(_table_name);
+        w.append(" set ");
 
-        for (int i = 0; i < data.size(); i++)
+        for (size_t i = _keys; i < _columns.size(); ++i)
         {
-            where_c.append("( NOT EXISTS (");
-            where_c.append(data[i].str());
-            where_c.append(" ) )  OR ");
+            if (i > _keys)
+                w.append(", ");
+            w.append(_columns[i]);
+            w.append(" = v.");
+            w.append(_columns[i]);
         }
-        where_c = where_c.substr(0, where_c.length() - 3);
-        _where_condition.push_back(where_c);
-        return *this;
+        w.append(" from (values ");
     }
 
-    template<typename T>
-    SelectModel& where_between(const  column& cond, const T& begin_val, const  T& end_val)
+    void render_row(SqlWriter& w, size_t row, bool cast) const
     {
-        std::string where_val;
+        size_t width = _columns.size();
 
-        where_val.append(cond.str());
-        std::string begin = std::to_string(begin_val);
-        std::string end   = std::to_string(end_val);
-        where_val.append(" BETWEEN " + begin + " AND " + end);
-        _where_condition.push_back(where_val);
-        return *this;
+        w.append("(");
+
+        for (size_t i = 0; i < width; ++i)
+        {
+            if (i > 0)
+                w.append(", ");
+            _value_nodes.render(w, _values[row * width + i]);
+
+            if (cast)
+                w.append(_casts[i]);
+        }
+        w.append(")");
     }
 
-    template<typename ... Args>
-    SelectModel& group_by(const std::string& str, Args&& ... columns)
+    void render_rows(SqlWriter& w, size_t first, size_t last) const
     {
-        _groupby_columns.push_back(str);
-        group_by(columns ...);
-        return *this;
+        for (size_t row = first; row < last; ++row)
+        {
+            if (row > first)
+                w.append(", ");
+            render_row(w, row, row == first);
+        }
     }
 
-    // for recursion
-    SelectModel& group_by()
+    void render_tail(SqlWriter& w) const
     {
-        return *this;
+        w.append(") as v(");
+        join_vector(w, _columns, ", ");
+        w.append(") where ");
+
+        for (size_t i = 0; i < _keys; ++i)
+        {
+            if (i > 0)
+                w.append(" and ");
+            w.append(_table_name);
+            w.append(".");
+            w.append(_columns[i]);
+            w.append(" = v.");
+            w.append(_columns[i]);
+        }
     }
 
-    SelectModel& having(const std::string& condition)
+    // end of the statement that starts at row first
+    size_t rows_end(const chunk_limits& limits, size_t fixed, size_t first) const
     {
-        _having_condition.push_back(condition);
-        return *this;
-    }
+        SqlWriter counter;
+        size_t rows = this->rows();
+        size_t last = first + 1;
+
+        render_row(counter, first, true);
+        size_t bytes = fixed + counter.size();
+
+        for (; last < rows; ++last)
+        {
+            size_t count = last - first + 1;
+            SqlWriter row;
+
+            render_row(row, last, false);
+            // , (row)
+            bytes += 2 + row.size();
+
+            if ((limits.max_rows && count > limits.max_rows) ||
+                (limits.max_params && count * _columns.size() > limits.max_params) ||
+                (limits.max_bytes && bytes > limits.max_bytes))
+                break;
+        }
+        return last;
+    }
+
+    std::pmr::string _table_name;
+    // quoted names, the keys first
+    std::pmr::vector<std::pmr::string> _columns;
+    size_t _keys = 0;
+    // cast of each column, "" until given or a value not null sets it
+    std::pmr::vector<std::pmr::string> _casts;
+    // one node of _value_nodes per column and row
+    std::pmr::vector<uint32_t> _values;
+    expression _value_nodes;
+};
+
+class DeleteModel : public SqlModel
+{
+public:
+    DeleteModel(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _table_name(resource),
+        _where_condition(resource) {}
+    DeleteModel(const DeleteModel& data) = default;
+    DeleteModel(DeleteModel&& data)      = default;
+    virtual ~DeleteModel() {}
 
-    SelectModel& having(const column& condition)
+    DeleteModel& _delete()
     {
-        _having_condition.push_back(condition.str());
         return *this;
     }
 
-    SelectModel& order_by(const std::string& order_by,  const bool desc = false)
+    template<typename ... Args>
+    DeleteModel& from(const std::string& table_name, const std::string& tablespace = "")
     {
-        _order_by      = order_by;
-        _order_by_desc = desc;
+        if (!tablespace.empty())
+        {
+            _table_name.append(tablespace);
+            _table_name.append(".");
+        }
+        append_quoted(_table_name, table_name);
+        _table_name.append(" ");
         return *this;
     }
 
-    SelectModel& order_by(const column& order_by,  const bool desc = false)
+    DeleteModel& from(const ident& table_name)
     {
-        _order_by      = to_value(order_by);
-        _order_by_desc = desc;
-        return *this;
-    }
+        append_quoted(_table_name, table_name);
+        _table_name.append(" ");
 
-    template<typename T>
-    SelectModel& limit(const T& limit)
-    {
-        _limit = std::to_string(limit);
         return *this;
     }
 
-    template<typename T>
-    SelectModel& limit(const T& offset, const T& limit)
+    DeleteModel& where(const std::string& condition)
     {
-        _offset = std::to_string(offset);
-        _limit  = std::to_string(limit);
+        _where_condition.push_back(column::raw(condition, _where_condition.get_allocator().resource()));
         return *this;
     }
 
-    template<typename T>
-    SelectModel& offset(const T& offset)
+    DeleteModel& where(column condition)
     {
-        _offset = std::to_string(offset);
+        _where_condition.push_back(std::move(condition));
         return *this;
     }
 
-    virtual const std::string& str() override
+    virtual void render(SqlWriter& w) const override
     {
-        _sql.clear();
-        _sql.append(" SELECT ");
-
-        if (_distinct)
-            _sql.append(" DISTINCT ");
-        join_vector(_sql, _select_columns, ", ");
-        _sql.append(" FROM ");
-        _sql.append(_table_name);
-
-        if (!_join_type.empty())
-        {
-            for (std::string  join :_join_type)
-            {
-                _sql.append(" " + join + " ");
-            }
-        }
+        w.append("delete from ");
+        w.append(_table_name);
 
         if (!_where_condition.empty())
         {
-            _sql.append(" WHERE ");
-            join_vector(_sql, _where_condition, " AND ");
-        }
-
-        if (!_groupby_columns.empty())
-        {
-            _sql.append(" group by ");
-            join_vector(_sql, _groupby_columns, ", ");
-        }
-
-        if (!_having_condition.empty())
-        {
-            _sql.append(" having ");
-            join_vector(_sql, _having_condition, " and ");
-        }
-
-        if (!_order_by.empty())
-        {
-            _sql.append(" ORDER BY ");
-            _sql.append(_order_by);
-
-            if (_order_by_desc)
-                _sql.append(" DESC ");
-        }
-
-        if (!_limit.empty())
-        {
-            _sql.append(" limit ");
-            _sql.append(_limit);
-        }
-
-        if (!_offset.empty())
-        {
-            _sql.append(" offset ");
-            _sql.append(_offset);
+            w.append(" WHERE ");
+            join_vector(w, _where_condition, " AND ");
         }
-        return _sql;
     }
 
-    SelectModel& reset()
+    DeleteModel& reset()
     {
-        _select_columns.clear();
-        _distinct = false;
-        _groupby_columns.clear();
         _table_name.clear();
-        _join_type.clear();
-        // 64_join_on_condition.clear();
         _where_condition.clear();
-        _having_condition.clear();
-        _order_by.clear();
-        _limit.clear();
-        _offset.clear();
         return *this;
     }
 
-    friend inline std::ostream& operator<<(std::ostream& out, SelectModel& mod)
+    friend inline std::ostream& operator<<(std::ostream& out, const DeleteModel& mod)
     {
-        out << mod.str();
+        SqlStreamSink sink(out);
+
+        mod.render_to(sink);
         return out;
     }
 
 protected:
-    std::vector<std::string> _select_columns;
-    bool _distinct;
-    std::vector<std::string> _groupby_columns;
-    std::string _table_name;
-    std::vector<std::string> _join_type;
+    virtual void detach() override
+    {
+        for (column& c : _where_condition)
+            c.detach();
+    }
 
-    // std::vector<std::string> _join_on_condition;
-    std::vector<std::string> _where_condition;
-    std::vector<std::string> _having_condition;
-    std::string _order_by;
-    bool _order_by_desc = false;
-    std::string _limit;
-    std::string _offset;
+    std::pmr::string _table_name;
+    std::pmr::vector<column> _where_condition;
 };
 
-inline std::string to_value(SelectModel& data)
+// position of a statement in the text of a StatementBatch, without its ";"
+struct statement_span
 {
-    return data.str();
-}
+    size_t offset;
+    size_t length;
+};
 
-class InsertModel : public SqlModel
+// Statements of one unit of work rendered into a single buffer, separated
+// by ";" and optionally wrapped in BEGIN and COMMIT. The buffer is sized
+// once for all of them and kept between renders. spans() locates each
+// statement, BEGIN and COMMIT included, for drivers that send them one by
+// one. Models are kept by reference and must outlive the batch's renders.
+class StatementBatch
 {
 public:
-    InsertModel() {}
-    virtual ~InsertModel() {}
+    StatementBatch(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+        _models(resource),
+        _spans(resource) {}
 
-    template<typename T>
-    InsertModel& insert(const std::string& c, const T& data)
+    StatementBatch& add(const SqlModel& model)
     {
-        if constexpr
-        (std::is_same<bool, T>::value)
-        {
-            _columns.push_back(quotes + c + quotes);
-            std::string v_data = "FALSE";
-
-            if (data) v_data =  "TRUE";
-            _values.push_back(v_data);
-        }
-        else
-            if constexpr (std::is_same<int, T>::value)
-            {
-                _columns.push_back(quotes + c + quotes);
-
-                _values.push_back(std::to_string(data));
-            }
-            else
-            {
-                _columns.push_back(quotes + c + quotes);
-                _values.push_back("'" + to_value(data) + "'");
-            }
+        _models.push_back(&model);
         return *this;
     }
 
-    InsertModel& insert(const std::string& c)
+    // a temporary would be gone by the time the batch renders
+    StatementBatch& add(const SqlModel&& model) = delete;
+
+    StatementBatch& transaction(bool wrap = true)
     {
-        _columns.push_back(quotes + c + quotes);
-        _values.push_back(" ? ");
+        _transaction = wrap;
         return *this;
     }
 
-    template<typename T>
-    InsertModel& operator()(const std::string& c, const T& data)
+    size_t size() const
     {
-        return insert(c, data);
+        return _models.size();
     }
 
-    InsertModel& operator()(const std::string& c)
+    // length in bytes of the text str() produces
+    size_t exact_size() const
     {
-        return insert(c);
-    }
+        size_t statements = _models.size() + (_transaction ? 2 : 0);
+        size_t size       = _transaction ? 11 : 0;  // BEGIN and COMMIT
 
-    InsertModel& into(const std::string& table_name, const std::string& tablespace = "")
-    {
-        _table_name.clear();
+        for (const SqlModel* model : _models)
+            size += model->exact_size();
 
-        if (!tablespace.empty())
-            _table_name.append(tablespace + ".");
-        _table_name.append(quotes + table_name + quotes);
-        return *this;
+        // a ";" between each two statements
+        return statements ? size + statements - 1 : 0;
     }
 
-    InsertModel& replace(bool var)
+    // renders every statement into the batch's buffer
+    const std::string& str()
     {
-        _replace = var;
-        return *this;
-    }
+        size_t size = exact_size();
 
-    virtual const std::string& str() override
-    {
         _sql.clear();
-        std::string v_ss;
+        _sql.reserve(size);
+        _spans.clear();
 
-        if (_replace)
-            _sql.append("insert or replace into ");
-        else
-            _sql.append("insert into ");
+        SqlWriter w(_sql);
 
-        _sql.append(_table_name);
-        _sql.append("(");
-        v_ss.append(" values(");
-        size_t size = _columns.size();
+        if (_transaction)
+            statement(w, "BEGIN");
 
-        for (size_t i = 0; i < size; ++i)
+        for (const SqlModel* model : _models)
         {
-            if (i < size - 1)
-            {
-                _sql.append(_columns[i]);
-                _sql.append(", ");
-                v_ss.append(_values[i]);
-                v_ss.append(", ");
-            }
-            else
-            {
-                _sql.append(_columns[i]);
-                _sql.append(")");
-                v_ss.append(_values[i]);
-                v_ss.append(")");
-            }
+            size_t offset = begin_statement(w);
+
+            model->render(w);
+            _spans.push_back(statement_span{offset, _sql.size() - offset});
         }
-        _sql.append(v_ss);
+
+        if (_transaction)
+            statement(w, "COMMIT");
         return _sql;
     }
 
-    InsertModel& reset()
+    // statements in the text of the last str()
+    const std::pmr::vector<statement_span>& spans() const
     {
-        _table_name.clear();
-        _columns.clear();
-        _values.clear();
+        return _spans;
+    }
+
+    std::string_view statement(size_t index) const
+    {
+        return std::string_view(_sql).substr(_spans[index].offset, _spans[index].length);
+    }
+
+    StatementBatch& reset()
+    {
+        _models.clear();
+        _spans.clear();
+        _transaction = false;
         return *this;
     }
 
-    friend inline std::ostream& operator<<(std::ostream& out, InsertModel& mod)
+private:
+    size_t begin_statement(SqlWriter& w) const
     {
-        out << mod.str();
-        return out;
+        if (!_spans.empty())
+            w.push_back(';');
+        return _sql.size();
     }
 
-protected:
-    bool _replace = false;
-    std::string _table_name;
-    std::vector<std::string> _columns;
-    std::vector<std::string> _values;
+    void statement(SqlWriter& w, std::string_view text)
+    {
+        size_t offset = begin_statement(w);
+
+        w.append(text);
+        _spans.push_back(statement_span{offset, text.size()});
+    }
+
+    std::pmr::vector<const SqlModel*> _models;
+    std::pmr::vector<statement_span> _spans;
+    std::string _sql;
+    bool _transaction = false;
 };
 
-template<>
-inline InsertModel& InsertModel::insert(const std::string& c, const std::nullptr_t&)
+struct parallel_options
+{
+    size_t threads = 0;  // 0 for std::thread::hardware_concurrency()
+    size_t chunk   = 256;  // statements a worker takes at a time
+    std::string_view separator = ";";
+};
+
+namespace detail {
+
+template<typename T>
+const SqlModel& model_of(const T& model)
 {
-    _columns.push_back(c);
-    _values.push_back("null");
-    return *this;
+    if constexpr (std::is_base_of<SqlModel, T>::value)
+        return model;
+    else
+        return *model;
 }
 
-class UpdateModel : public SqlModel
+// next unrendered chunk of a worker, taken by the worker and by those
+// stealing from it; on a line of its own so workers do not contend for it
+struct alignas(64) chunk_cursor
 {
-public:
-    UpdateModel() {}
-    virtual ~UpdateModel() {}
+    std::atomic<size_t> next{0};
+    size_t end = 0;
+};
 
-    UpdateModel& update(const std::string& table_name)
-    {
-        _table_name = table_name;
-        return *this;
-    }
+}
 
-    template<typename T>
-    UpdateModel& set(const std::string& c, const T& data)
+// Threads kept for render_parallel(), so that calls given the pool start
+// none. The calling thread works along as worker 0; calls on one pool run
+// one at a time.
+class SqlRenderPool
+{
+public:
+    // 0 for std::thread::hardware_concurrency() workers, the caller included
+    explicit SqlRenderPool(size_t threads = 0) :
+        _errors(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
     {
-        std::string str(c);
+        _threads.reserve(_errors.size() - 1);
 
-        str.append(" = ");
-        str.append(to_value(data));
-        _set_columns.push_back(str);
-        return *this;
+        try
+        {
+            for (size_t t = 1; t < _errors.size(); ++t)
+                _threads.emplace_back(&SqlRenderPool::work, this, t);
+        }
+        catch (...)
+        {
+            stop();
+            throw;
+        }
     }
 
-    template<typename T>
-    UpdateModel& operator()(const std::string& c, const T& data)
-    {
-        return set(c, data);
-    }
+    SqlRenderPool(const SqlRenderPool&) = delete;
+    SqlRenderPool& operator=(const SqlRenderPool&) = delete;
 
-    UpdateModel& where(const std::string& condition)
+    ~SqlRenderPool()
     {
-        _where_condition.push_back(condition);
-        return *this;
+        stop();
     }
 
-    UpdateModel& where(const column& condition)
+    size_t threads() const
     {
-        _where_condition.push_back(condition.str());
-        return *this;
+        return _errors.size();
     }
 
-    virtual const std::string& str() override
+    // calls job(worker) once for each worker and returns when all are done,
+    // rethrowing the first exception one of them threw
+    void run(const std::function<void(size_t)>& job)
     {
-        _sql.clear();
-        _sql.append("update ");
-        _sql.append(_table_name);
-        _sql.append(" set ");
-        join_vector(_sql, _set_columns, ", ");
-        size_t size = _where_condition.size();
+        std::lock_guard<std::mutex> call(_call);
 
-        if (size > 0)
         {
-            _sql.append(" WHERE ");
-            join_vector(_sql, _where_condition, " and ");
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            _job     = &job;
+            _running = _threads.size();
+            ++_generation;
+            std::fill(_errors.begin(), _errors.end(), nullptr);
         }
-        return _sql;
-    }
+        _wake.notify_all();
 
-    UpdateModel& reset()
-    {
-        _table_name.clear();
-        _set_columns.clear();
-        _where_condition.clear();
-        return *this;
+        try
+        {
+            job(0);
+        }
+        catch (...)
+        {
+            _errors[0] = std::current_exception();
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _done.wait(lock, [this] { return _running == 0; });
+        _job = nullptr;
+
+        for (const std::exception_ptr& error : _errors)
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
     }
 
-    friend inline std::ostream& operator<<(std::ostream& out, UpdateModel& mod)
+private:
+    void work(size_t worker)
     {
-        out << mod.str();
-        return out;
+        uint64_t generation = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        for (;;)
+        {
+            _wake.wait(lock, [&] { return _stop || _generation != generation; });
+
+            if (_stop)
+                return;
+            generation = _generation;
+            lock.unlock();
+
+            try
+            {
+                (*_job)(worker);
+            }
+            catch (...)
+            {
+                _errors[worker] = std::current_exception();
+            }
+            lock.lock();
+
+            if (--_running == 0)
+                _done.notify_one();
+        }
     }
 
-protected:
-    std::vector<std::string> _set_columns;
-    std::string _table_name;
-    std::vector<std::string> _where_condition;
+    // joins the threads started so far
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+
+        for (std::thread& thread : _threads)
+            thread.join();
+        _threads.clear();
+    }
+
+    std::mutex _call;   // held by run()
+    std::mutex _mutex;  // guards the fields below
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    const std::function<void(size_t)>* _job = nullptr;
+    uint64_t _generation = 0;
+    size_t _running      = 0;
+    bool _stop           = false;
+    std::vector<std::exception_ptr> _errors;  // one per worker
+    std::vector<std::thread> _threads;
 };
 
-template<>
-inline UpdateModel& UpdateModel::set(const std::string& c, const std::nullptr_t&)
+namespace detail {
+
+template<typename It>
+void render_serial(It first, It last, std::string& out, std::string_view separator)
 {
-    std::string str(c);
+    SqlWriter w(out);
+
+    for (It i = first; i != last; ++i)
+    {
+        if (i != first)
+            w.append(separator);
+        model_of(*i).render(w);
+    }
+}
 
-    str.append(" = null");
-    _set_columns.push_back(str);
-    return *this;
 }
 
-class DeleteModel : public SqlModel
+// Renders the models of [first, last), separated by options.separator, and
+// appends them to out in order, on the workers of pool. The range is cut
+// into chunks, each worker starts on its own share of them and, when done,
+// steals the remaining chunks of the others. A chunk is rendered into the
+// buffer of the worker that takes it; a second pass of the same workers
+// copies the chunks into place in out, each at an offset known in advance,
+// so no step takes a lock. The models are only read and may be pointers to
+// models.
+template<typename It>
+void render_parallel(SqlRenderPool& pool, It first, It last, std::string& out,
+                     const parallel_options& options = parallel_options())
 {
-public:
-    DeleteModel() {}
-    virtual ~DeleteModel() {}
+    size_t count   = static_cast<size_t>(last - first);
+    size_t chunk   = std::max<size_t>(options.chunk, 1);
+    size_t chunks  = (count + chunk - 1) / chunk;
+    size_t threads = std::min(options.threads ? options.threads : pool.threads(), pool.threads());
 
-    DeleteModel& _delete()
+    threads = std::min(threads, chunks);
+
+    if (threads <= 1)
     {
-        return *this;
+        detail::render_serial(first, last, out, options.separator);
+        return;
     }
 
-    template<typename ... Args>
-    DeleteModel& from(const std::string& table_name, const std::string& tablespace = "")
+    // the worker that rendered each chunk and where its text is in the
+    // worker's buffer, each written by one worker only
+    struct chunk_text
     {
-        if (!tablespace.empty())
-        {
-            _table_name.append(tablespace);
-            _table_name.append(".");
-        }
-        _table_name.append(quotes + table_name + quotes);
-        _table_name.append(" ");
+        size_t worker;
+        size_t offset;
+        size_t length;
+    };
 
-        return *this;
-    }
+    std::vector<chunk_text> texts(chunks);
+    std::vector<std::string> buffers(threads);
+    std::unique_ptr<detail::chunk_cursor[]> cursors(new detail::chunk_cursor[threads]);
 
-    DeleteModel& where(const std::string& condition)
+    for (size_t t = 0; t < threads; ++t)
     {
-        _where_condition.push_back(condition);
-        return *this;
+        cursors[t].next = chunks * t / threads;
+        cursors[t].end  = chunks * (t + 1) / threads;
     }
 
-    DeleteModel& where(const column& condition)
-    {
-        _where_condition.push_back(condition.str());
-        return *this;
-    }
+    auto render_chunk = [&](size_t worker, size_t index) {
+        std::string& buffer = buffers[worker];
+        size_t offset       = buffer.size();
+        size_t end          = std::min(count, (index + 1) * chunk);
+        SqlWriter w(buffer);
 
-    virtual const std::string& str() override
-    {
-        _sql.clear();
-        _sql.append("delete from ");
-        _sql.append(_table_name);
-        size_t size = _where_condition.size();
+        for (size_t i = index * chunk; i < end; ++i)
+        {
+            if (i > index * chunk)
+                w.append(options.separator);
+            detail::model_of(first[i]).render(w);
+        }
+        texts[index] = chunk_text{worker, offset, buffer.size() - offset};
+    };
+
+    pool.run([&](size_t worker) {
+        if (worker >= threads)
+            return;
 
-        if (size > 0)
+        for (size_t k = 0; k < threads; ++k)
         {
-            _sql.append(" WHERE ");
-            join_vector(_sql, _where_condition, " AND ");
+            detail::chunk_cursor& victim = cursors[(worker + k) % threads];
+
+            for (size_t index = victim.next++; index < victim.end; index = victim.next++)
+                render_chunk(worker, index);
         }
-        return _sql;
-    }
+    });
 
-    DeleteModel& reset()
+    // offsets of the chunks in out, then copied into place by the workers
+    std::vector<size_t> offsets(chunks);
+    size_t size = out.size();
+
+    for (size_t i = 0; i < chunks; ++i)
     {
-        _table_name.clear();
-        _where_condition.clear();
-        return *this;
+        if (i > 0)
+            size += options.separator.size();
+        offsets[i] = size;
+        size      += texts[i].length;
     }
+    out.resize(size);
+
+    pool.run([&](size_t worker) {
+        if (worker >= threads)
+            return;
+
+        for (size_t i = chunks * worker / threads; i < chunks * (worker + 1) / threads; ++i)
+        {
+            char* to = &out[offsets[i]];
+
+            if (i > 0)
+                std::memcpy(to - options.separator.size(), options.separator.data(), options.separator.size());
+            std::memcpy(to, buffers[texts[i].worker].data() + texts[i].offset, texts[i].length);
+        }
+    });
+}
 
-    friend inline std::ostream& operator<<(std::ostream& out, DeleteModel& mod)
+// render_parallel() on a pool of options.threads started for the call; a
+// pool kept by the caller saves starting them on every call
+template<typename It>
+void render_parallel(It first, It last, std::string& out, const parallel_options& options = parallel_options())
+{
+    size_t chunk   = std::max<size_t>(options.chunk, 1);
+    size_t chunks  = (static_cast<size_t>(last - first) + chunk - 1) / chunk;
+    size_t threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    threads = std::min(threads, chunks);
+
+    if (threads <= 1)
     {
-        out << mod.str();
-        return out;
+        detail::render_serial(first, last, out, options.separator);
+        return;
     }
 
-protected:
-    std::string _table_name;
-    std::vector<std::string> _where_condition;
-};
+    SqlRenderPool pool(threads);
+
+    render_parallel(pool, first, last, out, options);
+}
 
 }
@@ -0,0 +1,74 @@
+#pragma once
+
+// Replaces the global allocation functions with counting ones. Include it in
+// exactly one translation unit of a test or benchmark program.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace alloc_count {
+
+inline std::atomic<size_t> allocations(0);
+inline std::atomic<size_t> bytes(0);
+
+// allocations and bytes requested since construction
+struct scope
+{
+    size_t first_allocations = allocations.load();
+    size_t first_bytes       = bytes.load();
+
+    size_t count() const
+    {
+        return allocations.load() - first_allocations;
+    }
+
+    size_t size() const
+    {
+        return bytes.load() - first_bytes;
+    }
+};
+
+}
+
+// every allocation function forwards to these two, std::pmr's default
+// resource included
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    std::size_t alignment = std::max(static_cast<std::size_t>(align), sizeof(void*));
+    void* p = nullptr;
+
+    alloc_count::allocations.fetch_add(1, std::memory_order_relaxed);
+    alloc_count::bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (posix_memalign(&p, alignment, size ? size : 1) == 0)
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void* operator new(std::size_t size)
+{
+    return operator new(size, std::align_val_t(alignof(std::max_align_t)));
+}
+
+void operator delete(void* p) noexcept
+{
+    operator delete(p, std::align_val_t(alignof(std::max_align_t)));
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t align) noexcept
+{
+    operator delete(p, align);
+}
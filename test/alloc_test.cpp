@@ -0,0 +1,185 @@
+#include <cassert>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "sql.h"
+#include "alloc_count.h"
+
+// Upper bounds on the heap allocations of builder operations, so a hot path
+// that starts allocating again fails here instead of only showing in
+// sql-bench. The bounds are those of libstdc++.
+
+using namespace sql;
+
+int main()
+{
+    // One comparison: the shared arena, its node vector growing to three
+    // nodes and its text
+    {
+        alloc_count::scope scope;
+        column c = (column("x") == 1);
+        assert(scope.count() <= 4);
+    }
+
+    // A select with three joins
+    SelectModel s;
+    {
+        alloc_count::scope scope;
+        s.select("id", "name")
+            .from("user")
+            .left_join("a", column("a.id") == column("user.id"))
+            .left_join("b", column("b.id") == column("user.id"))
+            .left_join("c", column("c.id") == column("user.id"))
+            .where(column("age") > 18)
+            .limit(10);
+        assert(scope.count() <= 40);
+    }
+
+    // The first str() fills the clause cache and the statement, later calls
+    // reuse them
+    {
+        alloc_count::scope scope;
+        s.str();
+        assert(scope.count() <= 6);
+    }
+    {
+        alloc_count::scope scope;
+        s.str();
+        s.exact_size();
+        assert(scope.count() == 0);
+    }
+
+    // Paging re-renders only the tail clause, in place once it fits
+    s.offset(20).str();
+    {
+        alloc_count::scope scope;
+        s.offset(40).str();
+        assert(scope.count() == 0);
+    }
+
+    // A temporary subquery is moved into the statement, which allocates only
+    // the block it is shared through
+    {
+        SelectModel inner;
+
+        inner.select("id")
+            .from("user")
+            .where(column("age") > 18);
+        alloc_count::scope scope;
+        std::shared_ptr<const SelectModel> frozen = freeze(std::move(inner));
+        assert(scope.count() == 1);
+    }
+
+    // Rendering into memory of the caller, in place or with binds
+    {
+        char buffer[512];
+        std::string out;
+        SqlBinds binds;
+
+        out.reserve(1024);
+        binds.values.reserve(8);
+        alloc_count::scope scope;
+        s.render_to(buffer, sizeof(buffer));
+        s.render_to(out);
+        out.clear();
+        s.render_to(out, binds);
+        assert(scope.count() == 0);
+    }
+
+    // Value formatting, short strings stay within the small string buffer
+    {
+        std::string out;
+
+        out.reserve(64);
+        alloc_count::scope scope;
+        to_value(12345);
+        to_value("short");
+        append_value(out, 3.25);
+        append_value(out, 42);
+        append_value(out, "it's");
+        assert(scope.count() == 0);
+    }
+
+    // A 1000 element in-list grows its node vector and text geometrically
+    std::vector<int> ids(1000);
+
+    for (int i = 0; i < 1000; ++i)
+        ids[i] = i;
+    {
+        alloc_count::scope scope;
+        column c("id");
+        c.in(ids);
+        assert(scope.count() <= 20);
+    }
+
+    // join_vector and the expression walk render without allocating
+    DeleteModel d;
+    d.from("user")
+        .where(column("id").in(ids))
+        .where(column("age") > 18)
+        .where("name is not null");
+    d.str();
+    {
+        alloc_count::scope scope;
+        d.str();
+        assert(scope.count() == 0);
+    }
+
+    // Fingerprints hash the statement without writing it
+    {
+        alloc_count::scope scope;
+        s.fingerprint();
+        s.fingerprint();
+        d.fingerprint();
+        assert(scope.count() == 0);
+    }
+
+    // A model in an arena never touches the global heap
+    {
+        char arena_buffer[8192];
+        std::pmr::monotonic_buffer_resource arena(arena_buffer, sizeof(arena_buffer), std::pmr::null_memory_resource());
+        alloc_count::scope scope;
+        SelectModel sa(&arena);
+        sa.select("id", "name")
+            .from("user")
+            .where(column(&arena)("age") > 18);
+        std::pmr::string out(&arena);
+        sa.render_to(out);
+        assert(scope.count() == 0);
+    }
+
+    // Multi-row insert: node vector, text and value index growth only
+    InsertModel im;
+    im.into("user")
+        .columns("id", "name");
+    {
+        alloc_count::scope scope;
+        for (int row = 0; row < 100; ++row)
+            im.values(row, "n");
+        assert(scope.count() <= 23);
+    }
+
+    // A batch renders into one buffer, reused by later renders
+    StatementBatch batch;
+    batch.add(s)
+        .add(d)
+        .add(im)
+        .transaction();
+    batch.str();
+    {
+        alloc_count::scope scope;
+        batch.str();
+        assert(scope.count() == 0);
+    }
+
+    // A compiled template allocates only its result
+    SqlTemplate tpl(s);
+    {
+        alloc_count::scope scope;
+        tpl.render(30);
+        assert(scope.count() == 1);
+    }
+
+    return 0;
+}
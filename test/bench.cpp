@@ -0,0 +1,273 @@
+// Microbenchmarks of the builder, printed as JSON to compare runs between
+// versions:
+//
+//   sql-bench [min_ms] > before.json
+//
+// Every case repeats one operation for at least min_ms milliseconds (200 by
+// default) and reports the time per operation, the bytes of sql it produced
+// and the global heap allocations it made.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sql.h"
+#include "alloc_count.h"
+
+using namespace sql;
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+long long min_ns = 200000000;
+bool first_case  = true;
+// output sizes, so the work is not optimized away
+volatile size_t keep;
+
+// op() returns the size of the sql it rendered
+template<typename F>
+void bench(const std::string& name, F&& op)
+{
+    size_t bytes      = op();
+    size_t iterations = 0;
+    size_t batch      = 1;
+    alloc_count::scope allocated;
+    long long elapsed = 0;
+    bench_clock::time_point start = bench_clock::now();
+
+    for (;;)
+    {
+        for (size_t i = 0; i < batch; ++i)
+            keep = op();
+        iterations += batch;
+        elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count();
+
+        if (elapsed >= min_ns)
+            break;
+        batch *= 2;
+    }
+
+    std::printf("%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.1f, \"bytes\": %zu, \"allocs_per_op\": %.2f}",
+                first_case ? "" : ",", name.c_str(), iterations, double(elapsed) / iterations, bytes,
+                double(allocated.count()) / iterations);
+    first_case = false;
+}
+
+std::vector<std::string> names(const char* prefix, int count)
+{
+    std::vector<std::string> result;
+
+    for (int i = 0; i < count; ++i)
+        result.push_back(prefix + std::to_string(i));
+    return result;
+}
+
+SelectModel select_model(const std::vector<std::string>& tables, const std::vector<std::string>& keys, int count)
+{
+    SelectModel s;
+
+    s.select("id", "name", "age")
+        .from("user");
+
+    for (int i = 0; i < count; ++i)
+        s.left_join(tables[i], column("user.id") == column(keys[i]));
+
+    for (int i = 0; i < count; ++i)
+        s.where(column(tables[i]) > i);
+    s.order_by("id")
+        .limit(10);
+    return s;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        min_ns = std::atoll(argv[1]) * 1000000LL;
+
+    std::printf("{\n  \"benchmarks\": [");
+
+    std::vector<std::string> tables = names("t", 64);
+    std::vector<std::string> keys   = names("t.user_id", 64);
+
+    for (int count : {1, 8, 64})
+    {
+        std::string shape = "joins=" + std::to_string(count) + ",predicates=" + std::to_string(count);
+        SelectModel s     = select_model(tables, keys, count);
+
+        bench("select/str/" + shape, [&] {
+            return s.str().size();
+        });
+        bench("select/fingerprint/" + shape, [&] {
+            return size_t(s.fingerprint() & 1);
+        });
+        bench("select/fingerprint_const/" + shape, [&] {
+            return size_t(static_cast<const SelectModel&>(s).fingerprint() & 1);
+        });
+        bench("select/build/" + shape, [&] {
+            return select_model(tables, keys, count).str().size();
+        });
+
+        size_t page = 0;
+
+        bench("select/next_page/" + shape, [&] {
+            return s.offset(page += 10).str().size();
+        });
+    }
+
+    // a subquery passed as an lvalue is copied into the statement, a
+    // temporary is moved
+    bench("subquery/copy", [&] {
+        SelectModel inner = select_model(tables, keys, 8);
+        SelectModel s;
+
+        s.select("id")
+            .from("user")
+            .where(column("id").in(inner));
+        return s.str().size();
+    });
+    bench("subquery/move", [&] {
+        SelectModel s;
+
+        s.select("id")
+            .from("user")
+            .where(column("id").in(select_model(tables, keys, 8)));
+        return s.str().size();
+    });
+
+    for (int width : {16, 128})
+    {
+        std::vector<std::string> columns = names("c", width);
+
+        bench("insert/columns=" + std::to_string(width), [&] {
+            InsertModel i;
+
+            i.into("user");
+
+            for (int c = 0; c < width; ++c)
+            {
+                if (c % 2)
+                    i.insert(columns[c], c);
+                else
+                    i.insert(columns[c], "value");
+            }
+            return i.str().size();
+        });
+    }
+
+    bench("insert/rows=1000,columns=4", [&] {
+        InsertModel i;
+
+        i.into("user")
+            .columns("id", "name", "active", "score");
+
+        for (int row = 0; row < 1000; ++row)
+            i.values(row, "name", row % 2 == 0, 0.5 * row);
+        return i.str().size();
+    });
+
+    // rendering a backfill of 100k inserts on 1, 2, 4... threads up to the
+    // cores of the machine; ns_per_op should halve with each doubling
+    {
+        std::vector<InsertModel> backfill(100000);
+
+        for (size_t n = 0; n < backfill.size(); ++n)
+        {
+            backfill[n].into("event")
+                .insert("id", n)
+                .insert("name", "event")
+                .insert("score", 0.5 * n);
+        }
+
+        size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<size_t> counts;
+        std::string out;
+
+        for (size_t threads = 1; threads < cores; threads *= 2)
+            counts.push_back(threads);
+        counts.push_back(cores);
+
+        for (size_t threads : counts)
+        {
+            SqlRenderPool pool(threads);
+
+            bench("parallel/inserts=100000,threads=" + std::to_string(threads), [&] {
+                out.clear();
+                render_parallel(pool, backfill.begin(), backfill.end(), out);
+                return out.size();
+            });
+        }
+    }
+
+    for (int count : {10, 1000, 100000})
+    {
+        std::vector<int> ids(count);
+
+        for (int i = 0; i < count; ++i)
+            ids[i] = i;
+
+        bench("in/elements=" + std::to_string(count), [&] {
+            column c("id");
+
+            c.in(ids);
+            return c.str().size();
+        });
+    }
+
+    for (int terms : {16, 256, 4096})
+    {
+        bench("and_chain/terms=" + std::to_string(terms), [&] {
+            column chain = column("id") == 0;
+
+            for (int n = 1; n < terms; ++n)
+                chain = (chain and column("id") == n);
+            return chain.str().size();
+        });
+    }
+
+    bench("function/case", [] {
+        caseStatement c;
+
+        c.case_sql("label", "other", std::make_pair(column("a") == 1, "one"), std::make_pair(column("a") == 2, "two"));
+        return c.str().size();
+    });
+    bench("function/row_number", [] {
+        SqlWindowFunction w;
+
+        w.row_number(column("a"), column("p"), column("o"), true, "rn");
+        return w.str().size();
+    });
+    bench("function/dense_rank", [] {
+        SqlWindowFunction w;
+
+        w.dense_rank(column("p"), std::vector<std::pair<column, bool>>{{column("x"), true}, {column("y"), false}}, "dr");
+        return w.str().size();
+    });
+    bench("function/to_char", [] {
+        TimeFormatingFunction t;
+        DataTypeFormatingFunction d("day");
+
+        t.to_timestamp(column("created"));
+        d.to_char(t, true, "YYYY-MM-DD");
+        return d.str().size();
+    });
+    bench("function/coalesce", [] {
+        conditional_expressions c("value");
+
+        c.coalesce(column("a"), column("b"), 0);
+        return c.str().size();
+    });
+    bench("function/round_cast", [] {
+        RoundFunction r(CastFunction(column("price"), "numeric"), "price", 2);
+
+        return r.str().size();
+    });
+
+    std::printf("\n  ]\n}\n");
+    return 0;
+}
@@ -1,9 +1,17 @@
 #include <iostream>
 #include <cassert>
 #include <sstream>
+#include <fstream>
+#include <memory_resource>
+#include <thread>
+#include <atomic>
 
 #include "sql.h"
 
+#ifndef SQL_TEST_FIXTURES
+#define SQL_TEST_FIXTURES "fixtures/"
+#endif
+
 /*
 
 create table if not exists user (
@@ -20,6 +28,50 @@ create table if not exists user (
 
 using namespace sql;
 
+// the table above, declared as a type
+struct User
+{
+    SQL_TABLE(user);
+    SQL_COLUMN(id, uint32_t);
+    SQL_COLUMN(age, uint8_t);
+    SQL_COLUMN(score, uint32_t);
+    SQL_COLUMN(name, std::string);
+    SQL_COLUMN(address, std::string);
+    SQL_COLUMN(create_time, std::string);
+};
+
+// result holding two of its columns
+struct UserName
+{
+    using sql_columns = column_list<User::id, User::name>;
+
+    uint32_t id;
+    std::string name;
+};
+
+static std::string fixture(const std::string& name)
+{
+    std::ifstream in(SQL_TEST_FIXTURES + name, std::ios::binary);
+    std::ostringstream data;
+    data << in.rdbuf();
+    return data.str();
+}
+
+// true when f() throws E
+template<typename E, typename F>
+static bool throws(F&& f)
+{
+    try
+    {
+        f();
+    }
+    catch (const E&)
+    {
+        return true;
+    }
+    return false;
+}
+
 int main()
 {
     // Insert
@@ -31,7 +83,7 @@ int main()
             ("create_time", nullptr)
         .into("user");
     assert(i.str() ==
-            "insert into user(score, name, age, address, create_time) values(100, 'six', 20, 'beijing', null)");
+            "insert into \"user\"(\"score\", \"name\", \"age\", \"address\", \"create_time\") values(100, 'six', 20, 'beijing', null)");
 
     // Insert with named parameters
     InsertModel iP;
@@ -47,15 +99,14 @@ int main()
             ("create_time", create_time)
         .into("user");
     assert(iP.str() ==
-            "insert into user(score, name, age, address, create_time) values(:score, :name, :age, :address, :create_time)");
+            "insert into \"user\"(\"score\", \"name\", \"age\", \"address\", \"create_time\") values(:score, :name, :age, :address, :create_time)");
 
     // Select
     SelectModel s;
-    s.select("id as user_id", "age", "name", "address")
+    s.select(column("id", "", "user_id"), column("age"), column("name"), column("address"))
         .distinct()
         .from("user")
-        .join("score")
-        .on(column("user.id") == column("score.id") and column("score.id") > 60)
+        .left_join("score", column("id", "user") == column("id", "s") and column("id", "s") > 60, "", "s")
         .where(column("score") > 60 and (column("age") >= 20 or column("address").is_not_null()))
         // .where(column("score") > 60 && (column("age") >= 20 || column("address").is_not_null()))
         .group_by("age")
@@ -64,7 +115,7 @@ int main()
         .limit(10)
         .offset(1);
     assert(s.str() ==
-            "select distinct id as user_id, age, name, address from user join score on (user.id = score.id) and (score.id > 60) where (score > 60) and ((age >= 20) or (address is not null)) group by age having age > 10 order by age desc limit 10 offset 1");
+            " SELECT  DISTINCT \"id\" AS user_id, \"age\", \"name\", \"address\" FROM \"user\"   LEFT JOIN \"score\" s ON (user.\"id\" = s.\"id\") and (s.\"id\" > 60)  WHERE (\"score\" > 60) and ((\"age\" >= 20) or (\"address\" is not null)) group by age having \"age\" > 10 ORDER BY age desc limit 10 offset 1");
 
     // Update
     std::vector<int> a = {1, 2, 3};
@@ -76,7 +127,7 @@ int main()
             ("address", "beijing")
         .where(column("id").in(a));
     assert(u.str() ==
-            "update user set name = 'ddc', age = 18, score = null, address = 'beijing' where id in (1, 2, 3)");
+            "update user set name = 'ddc', age = 18, score = null, address = 'beijing' WHERE \"id\" in (1, 2, 3)");
 
     // Update with positional parameters
     UpdateModel uP;
@@ -88,7 +139,7 @@ int main()
             ("address", mark)
         .where(column("id").in(a));
     assert(uP.str() ==
-            "update user set name = ?, age = ?, score = ?, address = ? where id in (1, 2, 3)");
+            "update user set name = ?, age = ?, score = ?, address = ? WHERE \"id\" in (1, 2, 3)");
 
     // Delete
     DeleteModel d;
@@ -96,7 +147,735 @@ int main()
         .from("user")
         .where(column("id") == 1);
     assert(d.str() ==
-            "delete from user where id = 1");
+            "delete from \"user\"  WHERE \"id\" = 1");
+
+    // Render into a caller-supplied buffer
+    DeleteModel rd;
+    rd.from("user")
+        .where(column("id") == 1);
+    char buffer[64];
+    size_t length = rd.render_to(buffer, sizeof(buffer));
+    assert(length == rd.exact_size());
+    assert(std::string(buffer, length) == rd.str());
+    assert(rd.render_to(buffer, 4) == length);
+    std::string rendered("-- ");
+    rd.render_to(rendered);
+    assert(rendered == "-- " + rd.str());
+
+    // Builder state in a caller-supplied arena
+    char arena_buffer[4096];
+    std::pmr::monotonic_buffer_resource arena(arena_buffer, sizeof(arena_buffer), std::pmr::null_memory_resource());
+    SelectModel sa(&arena);
+    sa.select("id", "name")
+        .from("user")
+        .where(column(&arena)("age") > 18);
+    assert(sa.str() ==
+            " SELECT \"id\", \"name\" FROM \"user\"  WHERE \"age\" > 18");
+    const std::string& age_text = column("age").str();
+    std::string table_text = table("user").str();
+    assert(age_text == "\"age\"" && table_text == "\"user\" ");
+    assert(column("age").view() == age_text && column_value("x").view() == "'x'");
+    assert(column_value("o'hara").view() == "'o''hara'");
+    assert(column_value("o'hara", "text", "surname").view() == "'o''hara'::text AS surname");
+
+    // Predicate trees grow linearly with the and/or chain
+    column chain = column("id") == 0;
+    for (int n = 1; n < 100000; ++n)
+        chain = (chain or column("id") == n);
+    assert(chain.expr_tree()->size() == 3 * 100000 + 99999);
+    assert(chain.expr_tree()->node(chain.root()).kind == expr_kind::binary);
+    assert(chain.str().compare(0, 24, "((((((((((((((((((((((((") == 0);
+    assert(chain.str().substr(chain.str().size() - 19) == ") or (\"id\" = 99999)");
+
+    // Copies of a shared column change an arena of their own, never its
+    static const column shared_id("id");
+    std::vector<std::thread> builders;
+    std::atomic<int> wrong(0);
+    for (int t = 0; t < 4; ++t)
+    {
+        builders.emplace_back([&, t] {
+            for (int n = 0; n < 250; ++n)
+            {
+                DeleteModel dm;
+                dm.from("user")
+                    .where(column(shared_id) == n + t);
+                if (dm.str() != "delete from \"user\"  WHERE \"id\" = " + std::to_string(n + t))
+                    ++wrong;
+            }
+        });
+    }
+    for (std::thread& builder : builders)
+        builder.join();
+    assert(wrong == 0);
+    assert(shared_id.expr_tree()->size() == 1);
+    column source_id("id");
+    column other = source_id;
+    other > 1;
+    assert(source_id.str() == "\"id\"" && other.str() == "\"id\" > 1");
+    column both = (source_id and other);
+    other < 5;
+    assert(both.str() == "(\"id\") and (\"id\" > 1)");
+
+    // Compiled template with per-call values
+    SelectModel ts;
+    ts.select("id")
+        .from("user")
+        .where(column("age") > 18 and column("name") == Param(":name"))
+        .limit(10);
+    SqlTemplate tpl(ts);
+    assert(tpl.slots() == 3);
+    assert(tpl.is_param(1) && tpl.slot_value(1) == ":name");
+    assert(tpl.render() == ts.str());
+    assert(tpl.render(30, "bob") ==
+            " SELECT \"id\" FROM \"user\"  WHERE (\"age\" > 30) and (\"name\" = 'bob') limit 10");
+    assert(tpl.slot_type(0) == literal_type::integer && tpl.slot_type(1) == literal_type::null);
+    assert(tpl.render(30, Param("$1"), 5) ==
+            " SELECT \"id\" FROM \"user\"  WHERE (\"age\" > 30) and (\"name\" = $1) limit 5");
+    assert(throws<std::invalid_argument>([&] { tpl.render("oops"); }));
+    assert(throws<std::invalid_argument>([&] { tpl.render(30, "bob", 10, 1); }));
+    InsertModel flags;
+    flags.insert("id", 1)
+            ("active", true)
+            ("note", "x")
+        .into("user");
+    SqlTemplate flag_tpl(flags);
+    assert(flag_tpl.render() == flags.str());
+    assert(flag_tpl.render(2, false, nullptr) ==
+            "insert into \"user\"(\"id\", \"active\", \"note\") values(2, FALSE, null)");
+
+    // Multi-row insert split into chunks
+    InsertModel im;
+    im.into("user")
+        .columns("id", "name", "active");
+    for (int n = 0; n < 5; ++n)
+        im.values(n, "u", n % 2 == 0);
+    assert(im.rows() == 5);
+    assert(im.str() ==
+            "insert into \"user\"(\"id\", \"name\", \"active\") values(0, 'u', TRUE), (1, 'u', FALSE), (2, 'u', TRUE), (3, 'u', FALSE), (4, 'u', TRUE)");
+    chunk_limits limits;
+    limits.max_params = 6;
+    std::vector<std::string> chunks = im.chunks(limits);
+    assert(chunks.size() == 3);
+    assert(chunks[2] == "insert into \"user\"(\"id\", \"name\", \"active\") values(4, 'u', TRUE)");
+    limits.max_params = 0;
+    limits.max_bytes  = chunks[2].size() + 16;
+    assert(im.chunks(limits).size() == 5);
+    limits.max_bytes  = chunks[2].size() + 17;
+    assert(im.chunks(limits).size() == 3);
+    assert(throws<std::invalid_argument>([&] { im.values(5, "u"); }));
+    assert(throws<std::logic_error>([&] { im.columns("extra"); }));
+    assert(throws<std::logic_error>([&] { im.insert("extra", 1); }));
+    assert(throws<std::logic_error>([&] { im.insert("extra"); }));
+    assert(im.rows() == 5);
+    InsertModel one_row;
+    one_row.into("user")
+        .columns("id", "name")
+        .values(1, "u");
+    assert(throws<std::logic_error>([&] { one_row.insert("active", true); }));
+    assert(one_row.str() == "insert into \"user\"(\"id\", \"name\") values(1, 'u')");
+    one_row.reset();
+    one_row.insert("id", 1).into("user");
+    assert(one_row.str() == "insert into \"user\"(\"id\") values(1)");
+
+    // Streaming into a sink
+    std::vector<int> ids(20000);
+    for (int n = 0; n < 20000; ++n)
+        ids[n] = n;
+    DeleteModel sd;
+    sd.from("user")
+        .where(column("id").in(ids));
+    std::string streamed;
+    size_t largest = 0;
+    {
+        SqlCallbackSink sink([&](const char* data, size_t size) {
+            streamed.append(data, size);
+            largest = std::max(largest, size);
+        });
+        assert(sd.render_to(sink) == sd.exact_size());
+    }
+    assert(streamed == sd.str());
+    assert(largest <= 4096);
+    std::ostringstream os;
+    os << sd;
+    assert(os.str() == streamed);
+
+    // COPY FROM STDIN in text and binary format
+    InsertModel ci;
+    ci.into("user")
+        .columns("id", "name", "active", "score", "note");
+    CopyModel ct(ci);
+    ct.row(1, "six", true, 1.5, nullptr)
+        .row(2, std::string("tab\there\\back\nline"), false, -0.25, "x");
+    assert(ct.str() ==
+            "COPY \"user\"(\"id\", \"name\", \"active\", \"score\", \"note\") FROM STDIN");
+    assert(ct.data() == fixture("copy_user.txt"));
+    CopyModel cb(ci, copy_format::binary);
+    cb.row(1, "six", true, 1.5, nullptr)
+        .row(2, std::string("tab\there\\back\nline"), false, -0.25, "x")
+        .end();
+    assert(cb.str() ==
+            "COPY \"user\"(\"id\", \"name\", \"active\", \"score\", \"note\") FROM STDIN WITH (FORMAT binary)");
+    assert(cb.data() == fixture("copy_user.bin"));
+    InsertModel widths;
+    widths.into("counter")
+        .columns("small", "medium", "signed");
+    CopyModel cw(widths, copy_format::binary);
+    cw.row(uint16_t(40000), uint32_t(4000000000u), int16_t(-2));
+    assert(cw.data().substr(19) == std::string("\0\3" "\0\0\0\4" "\0\0\x9c\x40" "\0\0\0\x08" "\0\0\0\0\xee\x6b\x28\0"
+                                               "\0\0\0\2" "\xff\xfe", 28));
+    assert(throws<std::invalid_argument>([&] { cw.row(1, 2); }));
+
+    // Literals extracted into bind values
+    SelectModel banned;
+    banned.select("user_id")
+        .from("ban")
+        .where(column("reason") == "spam");
+    SelectModel bs;
+    bs.select("id")
+        .from("user")
+        .where(column("age") > 18)
+        .where_not_exists({banned})
+        .where(column("id").in(std::vector<int>{7, 8}))
+        .limit(10);
+    SqlBinds binds;
+    std::string bound;
+    bs.render_to(bound, binds);
+    assert(bound ==
+            " SELECT \"id\" FROM \"user\"  WHERE \"age\" > $1 AND ( NOT EXISTS ( SELECT \"user_id\" FROM \"ban\"  WHERE \"reason\" = $2 ) )   AND \"id\" in ($3, $4) limit $5");
+    assert(binds.values.size() == 5);
+    assert(binds.values[1].type == literal_type::text && binds.values[1].text == "spam");
+    assert(binds.values[3].type == literal_type::integer && binds.values[3].text == "8");
+    SelectModel mixed_params;
+    mixed_params.select("id")
+        .from("user")
+        .where(column("a") == Param("$1"))
+        .where(column("b") == 5);
+    SqlBinds mixed_binds;
+    std::string mixed_sql;
+    assert(throws<std::logic_error>([&] { mixed_params.render_to(mixed_sql, mixed_binds); }));
+    InsertModel insert_param;
+    insert_param.insert("a").into("user");
+    assert(throws<std::logic_error>([&] { insert_param.render_to(mixed_sql, mixed_binds); }));
+    assert(bs.str() ==
+            " SELECT \"id\" FROM \"user\"  WHERE \"age\" > 18 AND ( NOT EXISTS ( SELECT \"user_id\" FROM \"ban\"  WHERE \"reason\" = 'spam' ) )   AND \"id\" in (7, 8) limit 10");
+    UpdateModel bu;
+    bu.update("user")
+        .set("name", "ddc")
+            ("score", nullptr)
+        .where(column("id").in(banned));
+    SqlBinds question;
+    question.style = placeholder_style::question;
+    bound.clear();
+    bu.render_to(bound, question);
+    assert(bound == "update user set name = ?, score = ? WHERE \"id\" in ( SELECT \"user_id\" FROM \"ban\"  WHERE \"reason\" = ?)");
+    assert(question.values.size() == 3 && question.values[1].type == literal_type::null);
+
+    // Numbers formatted in place, floating point as shortest round trip
+    std::string formatted("x = ");
+    append_value(formatted, 0.1);
+    formatted.append(", ");
+    append_value(formatted, -9223372036854775807LL - 1);
+    assert(formatted == "x = 0.1, -9223372036854775808");
+    assert(to_value(1e-9) == "1e-09" && to_value(2.0) == "2");
+    SelectModel fs;
+    fs.select("id")
+        .from("user")
+        .where_between(column("score"), 0.5, 99.25)
+        .limit(20u, 10u);
+    assert(fs.str() ==
+            " SELECT \"id\" FROM \"user\"  WHERE \"score\" BETWEEN 0.5 AND 99.25 limit 10 offset 20");
+
+    // String literals escaped while rendering
+    assert(to_value("it's") == "'it''s'");
+    assert(to_value<std::string>(std::string("a\\b")) == "'a\\b'");
+    bool nul_rejected = false;
+    try
+    {
+        to_value<std::string>(std::string("nul\0", 4));
+    }
+    catch (const std::invalid_argument&)
+    {
+        nul_rejected = true;
+    }
+    assert(nul_rejected);
+    std::string clean(100, 'x');
+    std::string dirty(clean);
+    dirty[16] = '\'';
+    dirty[40] = '\\';
+    dirty[99] = '\'';
+    assert(to_value<std::string>(clean) == "'" + clean + "'");
+    assert(to_value<std::string>(dirty) == "'" + clean.substr(0, 16) + "''" + clean.substr(17, 23) + "\\" +
+            clean.substr(41, 58) + "'''");
+    DeleteModel ed;
+    ed.from("user")
+        .where(column("name").like("o'brien%"));
+    assert(ed.str() == "delete from \"user\"  WHERE \"name\" LIKE  'o''brien%' ");
+    SqlBinds raw_binds;
+    bound.clear();
+    ed.render_to(bound, raw_binds);
+    assert(bound == "delete from \"user\"  WHERE \"name\" LIKE  $1 ");
+    assert(raw_binds.values[0].text == "o'brien%");
+
+    // Large in-lists as one array value, bucketed, or split into statements
+    std::vector<int> few = {1, 2, 3, 4, 5};
+    DeleteModel ad;
+    ad.from("user")
+        .where(column("id").in(few, in_mode::array));
+    assert(ad.str() == "delete from \"user\"  WHERE \"id\" = ANY('{1,2,3,4,5}'::int4[])");
+    SqlBinds array_binds;
+    bound.clear();
+    ad.render_to(bound, array_binds);
+    assert(bound == "delete from \"user\"  WHERE \"id\" = ANY($1::int4[])");
+    assert(array_binds.values.size() == 1 && array_binds.values[0].text == "{1,2,3,4,5}");
+    std::vector<std::string> names = {"a", "b\"c"};
+    assert((column("name").not_in(names, in_mode::array)).str() == "\"name\" <> ALL('{\"a\",\"b\\\"c\"}'::text[])");
+    assert((column("id").in(few, in_mode::bucketed)).str() == "\"id\" in (1, 2, 3, 4, 5, 5, 5, 5)");
+    assert((column("id").in(std::vector<int>{1, 2}, in_mode::bucketed)).str() == "\"id\" in (1, 2)");
+    DeleteModel sp;
+    sp.from("user")
+        .where(column("id").in(few) and column("flag") == 1);
+    limits = chunk_limits();
+    limits.max_in_list = 2;
+    std::vector<std::string> split = sp.chunks(limits);
+    assert(split.size() == 3);
+    assert(split[0] == "delete from \"user\"  WHERE (\"id\" in (1, 2)) and (\"flag\" = 1)");
+    assert(split[2] == "delete from \"user\"  WHERE (\"id\" in (5)) and (\"flag\" = 1)");
+    limits.max_in_list = 5;
+    assert(sp.chunks(limits).size() == 1 && sp.chunks(limits)[0] == sp.str());
+
+    // One frozen model rendered by many threads while its source changes
+    column shared_age("age");
+    SelectModel shared_select;
+    shared_select.select("id")
+        .from("user")
+        .where(shared_age > 18)
+        .where_exists({banned});
+    std::shared_ptr<const SelectModel> frozen = freeze(shared_select);
+    const std::string expected = frozen->str();
+    assert(expected == shared_select.str());
+    std::vector<std::thread> readers;
+    std::atomic<int> mismatches(0);
+    for (int t = 0; t < 4; ++t)
+    {
+        readers.emplace_back([&] {
+            char buffer[256];
+            for (int n = 0; n < 1000; ++n)
+            {
+                size_t size = frozen->render_to(buffer, sizeof(buffer));
+                if (frozen->str() != expected || std::string(buffer, size) != expected)
+                    ++mismatches;
+            }
+        });
+    }
+    for (int n = 0; n < 1000; ++n)
+        shared_age < n;
+    for (std::thread& reader : readers)
+        reader.join();
+    assert(mismatches == 0);
+
+    // Clause cache of str() follows every change
+    SelectModel page;
+    page.select("id")
+        .from("user")
+        .where(column("age") > 18)
+        .order_by("id")
+        .limit(100);
+    const SelectModel& fresh = page;
+    for (int n = 0; n < 5; ++n)
+    {
+        page.offset(n * 100);
+        assert(page.str() == fresh.str());
+    }
+    page.where(column("name").is_not_null());
+    assert(page.str() == fresh.str());
+    page.select("name").distinct().group_by("id", "name").having("count(*) > 1");
+    assert(page.str() == fresh.str());
+    page.left_join("score", column("score.id") == column("user.id"));
+    assert(page.str() == fresh.str());
+    page.reset().select("id").from("t");
+    assert(page.str() == " SELECT \"id\" FROM \"t\" ");
+    SelectModel moved(std::move(page));
+    assert(moved.str() == " SELECT \"id\" FROM \"t\" ");
+    assert(page.str() == SelectModel().str());
+    page.select("id").from("u");
+    assert(page.str() == " SELECT \"id\" FROM \"u\" ");
+    page = std::move(moved);
+    assert(page.str() == " SELECT \"id\" FROM \"t\" " && moved.str() == SelectModel().str());
+    assert(moved.reset().from("v").str() == " SELECT  FROM \"v\" ");
+    SelectModel sub_moved;
+    sub_moved.select("user_id").from("ban");
+    column banned_ids = column("id").in(std::move(sub_moved));
+    assert(banned_ids.str() == "\"id\" in ( SELECT \"user_id\" FROM \"ban\" )");
+    assert(sub_moved.str() == SelectModel().str());
+
+    // keyset pagination
+    SelectModel feed;
+    feed.select("id", "title")
+        .from("post")
+        .where(column("published") == true)
+        .order_by_keys({{"created_at", true, nulls_order::last}, {"id", true}})
+        .limit(20);
+    assert(feed.str() == " SELECT \"id\", \"title\" FROM \"post\"  WHERE \"published\" = 1"
+            " ORDER BY \"created_at\" DESC NULLS LAST, \"id\" DESC limit 20");
+    feed.seek_after("2024-01-01", 42);
+    assert(feed.str() == " SELECT \"id\", \"title\" FROM \"post\"  WHERE \"published\" = 1"
+            " AND (\"created_at\", \"id\") < ('2024-01-01', 42)"
+            " ORDER BY \"created_at\" DESC NULLS LAST, \"id\" DESC limit 20");
+    SqlBinds feed_binds;
+    std::string feed_sql;
+    feed.render_to(feed_sql, feed_binds);
+    assert(feed_sql.find("(\"created_at\", \"id\") < ($2, $3)") != std::string::npos);
+    assert(feed_binds.values.size() == 4 && feed_binds.values[1].text == "2024-01-01");
+    assert(feed.str() == feed.seek_after("2024-01-01", 42).str());
+    SelectModel mixed;
+    mixed.select("*").from("t").order_by_keys({{"a"}, {"b", true}}).seek_after(1, 2);
+    assert(mixed.str() == " SELECT \"*\" FROM \"t\"  WHERE ((\"a\" > 1) OR (\"a\" = 1 AND \"b\" < 2)) ORDER BY \"a\", \"b\" DESC");
+    mixed.seek_after();
+    assert(mixed.str() == " SELECT \"*\" FROM \"t\"  ORDER BY \"a\", \"b\" DESC");
+    mixed.order_by_keys({{"t.a"}, {"b"}}).seek_after(1, 2);
+    assert(mixed.str() == " SELECT \"*\" FROM \"t\"  WHERE (t.\"a\", \"b\") > (1, 2) ORDER BY t.\"a\", \"b\"");
+    assert(throws<std::invalid_argument>([&] { mixed.seek_after(1); }));
+    assert(throws<std::invalid_argument>([&] { mixed.seek_after(1, 2, 3); }));
+    assert(mixed.str() == " SELECT \"*\" FROM \"t\"  WHERE (t.\"a\", \"b\") > (1, 2) ORDER BY t.\"a\", \"b\"");
+    mixed.order_by("a");
+    assert(throws<std::invalid_argument>([&] { mixed.seek_after(1); }));
+    assert(mixed.str() == " SELECT \"*\" FROM \"t\"  ORDER BY a");
+
+    // interned identifiers
+    SqlIdentifiers registry;
+    ident user_table = registry.intern("user", "app");
+    ident user_id    = registry.intern("id");
+    ident user_name  = registry.intern("name");
+    assert(registry.intern("id") == user_id && registry.intern("user", "app") == user_table);
+    assert(user_table != registry.intern("user"));
+    assert(user_table.sql() == "app.\"user\"" && user_table.name() == "user");
+    assert(registry[user_id.id()] == user_id && registry.find("name") == user_name && !registry.find("missing"));
+    SelectModel interned;
+    interned.select(column(user_id), column(user_name, "u"))
+        .from(user_table, "u")
+        .left_join(registry.intern("score"), column("score.id") == column(user_id, "u"));
+    SelectModel spelled;
+    spelled.select(column("id"), column("name", "u"))
+        .from("user", "app", "u")
+        .left_join("score", column("score.id") == column("id", "u"));
+    assert(interned.str() == spelled.str());
+    InsertModel interned_insert;
+    interned_insert.insert(user_id, 1)
+        .insert(user_name, "x")
+        .into(user_table);
+    assert(interned_insert.str() == "insert into app.\"user\"(\"id\", \"name\") values(1, 'x')");
+    std::vector<std::thread> interning;
+    std::atomic<int> interned_mismatches(0);
+    for (int t = 0; t < 4; ++t)
+        interning.emplace_back([&registry, &interned_mismatches, user_id] {
+            for (int n = 0; n < 200; ++n)
+            {
+                ident a = registry.intern("c" + std::to_string(n));
+                if (registry.intern("c" + std::to_string(n)) != a || a.sql() != "\"c" + std::to_string(n) + "\"" ||
+                    registry.intern("id") != user_id)
+                    ++interned_mismatches;
+            }
+        });
+    for (std::thread& t : interning)
+        t.join();
+    assert(interned_mismatches == 0 && registry.size() == 205);
+
+    // schema descriptors
+    static_assert(User::name::sql_quoted == "\"name\"" && User::age::sql_type == literal_type::integer);
+    SelectModel described;
+    described.select<User::id, User::name>()
+        .from<User>()
+        .where(column::of<User::age>() > 18);
+    assert(described.str() == " SELECT \"id\", \"name\" FROM \"user\"  WHERE \"age\" > 18");
+    SelectModel projected;
+    projected.select<UserName>().from<User>();
+    SelectModel projected_row;
+    projected_row.select<row<User::id, User::name>>().from<User>();
+    assert(projected.str() == " SELECT \"id\", \"name\" FROM \"user\" " && projected_row.str() == projected.str());
+    row<User::id, User::name, User::score> user_row;
+    user_row.get<User::name>() = "n";
+    user_row.get<User::score>() = 3;
+    assert(user_row.get<User::name>() == "n" && user_row.get<User::score>() == 3);
+    InsertModel described_insert;
+    described_insert.insert<User::id>(1)
+        .insert<User::name>("x")
+        .into<User>();
+    assert(described_insert.str() == "insert into \"user\"(\"id\", \"name\") values(1, 'x')");
+
+    // bulk update
+    BulkUpdateModel bulk;
+    bulk.update("user")
+        .columns("name", "score")
+        .keys("id")
+        .values(1, "a", 10)
+        .values(2, "b'", 20)
+        .values(3, "c", 30);
+    assert(bulk.str() == "update \"user\" set \"name\" = v.\"name\", \"score\" = v.\"score\" from (values "
+            "(1::int4, 'a'::text, 10::int4), (2, 'b''', 20), (3, 'c', 30)) as v(\"id\", \"name\", \"score\")"
+            " where \"user\".\"id\" = v.\"id\"");
+    SqlBinds bulk_binds;
+    std::string bulk_sql;
+    bulk.render_to(bulk_sql, bulk_binds);
+    assert(bulk_binds.values.size() == 9);
+    assert(bulk_sql.find("(values ($1::int4, $2::text, $3::int4), ($4, $5, $6)") != std::string::npos);
+    chunk_limits bulk_limits;
+    bulk_limits.max_rows = 2;
+    std::vector<std::string> bulk_chunks = bulk.chunks(bulk_limits);
+    assert(bulk_chunks.size() == 2);
+    assert(bulk_chunks[1] == "update \"user\" set \"name\" = v.\"name\", \"score\" = v.\"score\" from (values "
+            "(3::int4, 'c'::text, 30::int4)) as v(\"id\", \"name\", \"score\") where \"user\".\"id\" = v.\"id\"");
+    chunk_limits bulk_bytes;
+    bulk_bytes.max_bytes = bulk_chunks[1].size() + 10;
+    for (const std::string& sql : bulk.chunks(bulk_bytes))
+        assert(sql.size() <= bulk_bytes.max_bytes);
+    BulkUpdateModel keyed;
+    keyed.update("stock", "app")
+        .keys("shop", "item")
+        .columns("count")
+        .values(1, 2, true);
+    assert(keyed.str() == "update app.\"stock\" set \"count\" = v.\"count\" from (values (1::int4, 2::int4, TRUE::bool))"
+            " as v(\"shop\", \"item\", \"count\") where app.\"stock\".\"shop\" = v.\"shop\" and app.\"stock\".\"item\" = v.\"item\"");
+    assert(throws<std::invalid_argument>([&] { keyed.values(1, 2); }));
+    assert(throws<std::logic_error>([&] { keyed.keys("region"); }));
+    BulkUpdateModel sparse;
+    sparse.update("user")
+        .keys("id")
+        .columns("score")
+        .values(1, nullptr)
+        .values(2, 5);
+    assert(sparse.str() == "update \"user\" set \"score\" = v.\"score\" from (values (1::int4, null::int4), (2, 5))"
+            " as v(\"id\", \"score\") where \"user\".\"id\" = v.\"id\"");
+    BulkUpdateModel typed;
+    typed.update("session")
+        .keys("token")
+        .columns("seen")
+        .cast("token", "uuid")
+        .cast("seen", "timestamptz")
+        .values("a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11", "2024-01-01 00:00:00+00");
+    assert(typed.str() == "update \"session\" set \"seen\" = v.\"seen\" from (values"
+            " ('a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'::uuid, '2024-01-01 00:00:00+00'::timestamptz))"
+            " as v(\"token\", \"seen\") where \"session\".\"token\" = v.\"token\"");
+    assert(throws<std::invalid_argument>([&] { typed.cast("missing", "int4"); }));
+
+    // upsert
+    InsertModel upsert;
+    upsert.into("user")
+        .columns("id", "name", "score")
+        .values(1, "a", 10)
+        .values(2, "b", 20)
+        .on_conflict("id")
+        .do_update("name", "score")
+        .do_update_where(column("score", "user") < 15);
+    assert(upsert.str() == "insert into \"user\"(\"id\", \"name\", \"score\") values(1, 'a', 10), (2, 'b', 20)"
+            " on conflict (\"id\") do update set \"name\" = excluded.\"name\", \"score\" = excluded.\"score\""
+            " where user.\"score\" < 15");
+    SqlBinds upsert_binds;
+    std::string upsert_sql;
+    upsert.render_to(upsert_sql, upsert_binds);
+    assert(upsert_binds.values.size() == 7 && upsert_sql.find("where user.\"score\" < $7") != std::string::npos);
+    chunk_limits upsert_limits;
+    upsert_limits.max_rows = 1;
+    std::vector<std::string> upsert_chunks = upsert.chunks(upsert_limits);
+    assert(upsert_chunks.size() == 2);
+    assert(upsert_chunks[1] == "insert into \"user\"(\"id\", \"name\", \"score\") values(2, 'b', 20)"
+            " on conflict (\"id\") do update set \"name\" = excluded.\"name\", \"score\" = excluded.\"score\""
+            " where user.\"score\" < 15");
+    InsertModel ingest;
+    ingest.into("event")
+        .columns("shop", "seq")
+        .values(1, 2)
+        .on_conflict("shop", "seq")
+        .do_nothing();
+    assert(ingest.str() == "insert into \"event\"(\"shop\", \"seq\") values(1, 2) on conflict (\"shop\", \"seq\") do nothing");
+    ingest.on_conflict_constraint("event_pkey");
+    assert(ingest.str() == "insert into \"event\"(\"shop\", \"seq\") values(1, 2) on conflict on constraint \"event_pkey\" do nothing");
+    InsertModel skip;
+    skip.into("event")
+        .columns("shop", "seq")
+        .values(1, 2)
+        .do_nothing();
+    assert(skip.str() == "insert into \"event\"(\"shop\", \"seq\") values(1, 2) on conflict do nothing");
+    skip.reset();
+    skip.into("event")
+        .columns("shop", "seq")
+        .values(1, 2)
+        .on_conflict("shop");
+    assert(skip.str() == "insert into \"event\"(\"shop\", \"seq\") values(1, 2) on conflict (\"shop\") do nothing");
+    skip.reset();
+    skip.into("event")
+        .columns("shop", "seq")
+        .values(1, 2)
+        .do_update("seq");
+    bool untargeted_update = false;
+    try
+    {
+        skip.str();
+    }
+    catch (const std::logic_error&)
+    {
+        untargeted_update = true;
+    }
+    assert(untargeted_update);
+    skip.reset();
+    skip.into("event")
+        .columns("shop", "seq")
+        .values(1, 2);
+    assert(throws<std::logic_error>([&] { skip.on_conflict(); }));
+    assert(throws<std::logic_error>([&] { skip.on_conflict("shop").do_update(); }));
+    assert(skip.str() == "insert into \"event\"(\"shop\", \"seq\") values(1, 2) on conflict (\"shop\") do nothing");
+
+    // statement batch
+    InsertModel batch_insert;
+    batch_insert.insert("id", 1).into("user");
+    UpdateModel batch_update;
+    batch_update.update("user").set("name", "x").where(column("id") == 1);
+    DeleteModel batch_delete;
+    batch_delete.from("session").where(column("user_id") == 1);
+    StatementBatch batch;
+    batch.add(batch_insert)
+        .add(batch_update)
+        .add(batch_delete);
+    assert(batch.str() == batch_insert.str() + ";" + batch_update.str() + ";" + batch_delete.str());
+    assert(batch.spans().size() == 3 && batch.statement(1) == batch_update.str());
+    assert(batch.exact_size() == batch.str().size());
+    size_t batch_capacity = batch.str().capacity();
+    batch.transaction();
+    assert(batch.str() == "BEGIN;" + batch_insert.str() + ";" + batch_update.str() + ";" + batch_delete.str() + ";COMMIT");
+    assert(batch.spans().size() == 5 && batch.statement(0) == "BEGIN" && batch.statement(4) == "COMMIT");
+    assert(batch.statement(3) == batch_delete.str() && batch.str().capacity() >= batch_capacity);
+    assert(batch.exact_size() == batch.str().size());
+    StatementBatch empty_batch;
+    assert(empty_batch.exact_size() == 0 && empty_batch.str().empty());
+    empty_batch.transaction();
+    assert(empty_batch.str() == "BEGIN;COMMIT" && empty_batch.exact_size() == 12);
+
+    // parallel rendering
+    std::vector<InsertModel> backfill(100);
+    for (size_t n = 0; n < backfill.size(); ++n)
+        backfill[n].insert("id", n).insert("name", "n" + std::to_string(n)).into("user");
+    std::string serial;
+    for (size_t n = 0; n < backfill.size(); ++n)
+        serial.append(n ? ";" : "").append(backfill[n].str());
+    parallel_options parallel;
+    parallel.threads = 4;
+    parallel.chunk   = 3;
+    std::string stitched = "-- backfill\n";
+    render_parallel(backfill.begin(), backfill.end(), stitched, parallel);
+    assert(stitched == "-- backfill\n" + serial);
+    std::vector<const SqlModel*> backfill_models;
+    for (const InsertModel& m : backfill)
+        backfill_models.push_back(&m);
+    parallel.threads = 8;
+    parallel.chunk   = 1;
+    stitched.clear();
+    render_parallel(backfill_models.begin(), backfill_models.end(), stitched, parallel);
+    assert(stitched == serial);
+    parallel.threads = 1;
+    stitched.clear();
+    render_parallel(backfill.begin(), backfill.end(), stitched, parallel);
+    assert(stitched == serial);
+    stitched.clear();
+    render_parallel(backfill.begin(), backfill.begin(), stitched, parallel);
+    assert(stitched.empty());
+    SqlRenderPool render_pool(3);
+    parallel.threads = 0;
+    parallel.chunk   = 7;
+    for (int n = 0; n < 3; ++n)
+    {
+        stitched.clear();
+        render_parallel(render_pool, backfill.begin(), backfill.end(), stitched, parallel);
+        assert(stitched == serial);
+    }
+    std::vector<InsertModel> failing(backfill.begin(), backfill.begin() + 20);
+    failing[15].do_update("name");
+    stitched.clear();
+    assert(throws<std::logic_error>([&] { render_parallel(render_pool, failing.begin(), failing.end(), stitched, parallel); }));
+    stitched.clear();
+    render_parallel(render_pool, backfill.begin(), backfill.end(), stitched, parallel);
+    assert(stitched == serial && render_pool.threads() == 3);
+
+    // fingerprints
+    SelectModel shape_a;
+    shape_a.select("id").from("user").where(column("age") > 18).where(column("id").in(std::vector<int>{1, 2, 3})).limit(10);
+    SelectModel shape_b;
+    shape_b.select("id").from("user").where(column("age") > 40).where(column("id").in(std::vector<int>{7})).limit(20);
+    SelectModel shape_c;
+    shape_c.select("id").from("user").where(column("age") < 18).where(column("id").in(std::vector<int>{1, 2, 3})).limit(10);
+    assert(shape_a.fingerprint() == shape_b.fingerprint() && shape_a.fingerprint() != shape_c.fingerprint());
+    const SelectModel& shape_const = shape_a;
+    assert(shape_const.fingerprint() == shape_a.fingerprint());
+    uint64_t page_shape = shape_a.fingerprint();
+    shape_a.offset(100);
+    assert(shape_a.fingerprint() != page_shape && shape_a.fingerprint() == shape_const.fingerprint());
+    shape_b.offset(5000);
+    assert(shape_a.fingerprint() == shape_b.fingerprint());
+    SelectModel shape_text;
+    shape_text.select("id").from("user").where(column("name") == "a'b");
+    SelectModel shape_other_text;
+    shape_other_text.select("id").from("user").where(column("name") == "c");
+    assert(shape_text.fingerprint() == shape_other_text.fingerprint());
+    InsertModel insert_a;
+    insert_a.insert("id", 1).insert("name", "a").into("user");
+    InsertModel insert_b;
+    insert_b.insert("id", 2).insert("name", "bb").into("user");
+    assert(insert_a.fingerprint() == insert_b.fingerprint());
+    insert_b.insert("age", 3);
+    assert(insert_a.fingerprint() != insert_b.fingerprint());
+    UpdateModel update_a;
+    update_a.update("user").set("name", "a").where(column("id") == 1);
+    UpdateModel update_b;
+    update_b.update("user").set("name", "b").where(column("id") == 2);
+    DeleteModel delete_a;
+    delete_a.from("user").where(column("id").in(std::vector<int>{1, 2}));
+    DeleteModel delete_b;
+    delete_b.from("user").where(column("id").in(std::vector<int>{3, 4, 5, 6}));
+    assert(update_a.fingerprint() == update_b.fingerprint() && delete_a.fingerprint() == delete_b.fingerprint());
+    assert(update_a.fingerprint() != delete_a.fingerprint());
+    std::string delete_sql;
+    uint64_t delete_shape = 0;
+    delete_b.render_to(delete_sql, delete_shape);
+    assert(delete_sql == delete_b.str() && delete_shape == delete_a.fingerprint());
+    std::string text_sql;
+    uint64_t text_shape = 0;
+    shape_text.render_to(text_sql, text_shape);
+    assert(text_sql == shape_text.str() && text_shape == shape_other_text.fingerprint());
+    shape_c.where(column("name").in(std::vector<std::string>{"a", "b"}));
+    shape_c.str();
+    assert(shape_c.fingerprint() == static_cast<const SelectModel&>(shape_c).fingerprint());
+
+#if __cplusplus >= 202002L
+    // Statement text fixed at compile time
+    constexpr auto by_age = static_select<"id", "name">()
+        .from<"user">()
+        .where<"age", ">">()
+        .where<"name">()
+        .limit()
+        .offset();
+    static_assert(by_age.slots() == 4);
+    static_assert(by_age.text() ==
+            " SELECT \"id\", \"name\" FROM \"user\"  WHERE \"age\" >  AND \"name\" =  limit  offset ");
+    static_assert(by_age.slot_position(0) == 48);
+    SelectModel dyn;
+    dyn.select("id", "name")
+        .from("user")
+        .where(column("age") > 18)
+        .where(column("name") == "o'hara")
+        .limit(10)
+        .offset(20);
+    assert(by_age.render(18, "o'hara", 10, 20) == dyn.str());
+    SqlBinds static_binds;
+    SqlBinds dynamic_binds;
+    std::string static_sql;
+    std::string dynamic_sql;
+    by_age.render_to(static_sql, static_binds, 18, "o'hara", 10, 20);
+    dyn.render_to(dynamic_sql, dynamic_binds);
+    assert(static_sql == dynamic_sql);
+    assert(static_binds.values.size() == 4 && static_binds.values[1].text == "o'hara");
+    constexpr auto described_skeleton = static_select<User::id, User::name>()
+        .from<User>()
+        .where<"age", ">">();
+    static_assert(described_skeleton.text() == " SELECT \"id\", \"name\" FROM \"user\"  WHERE \"age\" > ");
+#endif
 
     return 0;
 }